@@ -0,0 +1,132 @@
+#if XH_INCLUDE_BENCHMARKS
+
+///////////////////////////////////////////////////////////////////////////////
+/**
+	Shared by the benchmarks: measures how many short tasks per second a
+	TaskThreadPool gets through, with the tasks added either from the calling
+	thread or from several producer threads at once.
+*/
+///////////////////////////////////////////////////////////////////////////////
+
+class PoolThroughput
+{
+public:
+
+	/** Runs the tasks, and returns the rate they were completed at.
+
+		@param	numProducers	The number of threads adding tasks. If this is
+								0, they're all added by the calling thread.
+		@param	numCompleted	Set to the number of tasks which finished,
+								which should be the number returned by
+								getNumTasksToRun().
+	*/
+	static double measure (TaskThreadPool::SchedulerType type, int numWorkers, int numProducers,
+						   int numTasks, int& numCompleted)
+	{
+		TaskThreadPool pool (numWorkers, type);
+
+		const int tasksPerProducer = numProducers > 0 ? numTasks / numProducers : numTasks;
+		const int target = getNumTasksToRun (numProducers, numTasks);
+
+		Atomic<int> counter;
+		WaitableEvent finished;
+		OwnedArray<Producer> producers;
+
+		for (int i = 0; i < numProducers; ++i)
+			producers.add (new Producer (pool, tasksPerProducer, counter, target, finished));
+
+		const int64 startTicks = Time::getHighResolutionTicks ();
+
+		if (numProducers > 0)
+		{
+			for (int i = 0; i < producers.size(); ++i)
+				producers.getUnchecked (i)->startThread ();
+		}
+		else
+		{
+			for (int i = 0; i < target; ++i)
+				pool.addTask (new CountingTask (counter, target, finished));
+		}
+
+		finished.wait (60000);
+
+		const double seconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks () - startTicks);
+
+		for (int i = 0; i < producers.size(); ++i)
+			producers.getUnchecked (i)->waitForThreadToExit (-1);
+
+		numCompleted = counter.get();
+
+		return seconds > 0.0 ? target / seconds : 0.0;
+	}
+
+	/** Returns the number of tasks measure() actually runs, as the tasks are
+		split evenly between the producers. */
+	static int getNumTasksToRun (int numProducers, int numTasks)
+	{
+		return numProducers > 0 ? (numTasks / numProducers) * numProducers : numTasks;
+	}
+
+private:
+
+	class CountingTask	:	public ProgressiveTask
+	{
+	public:
+
+		CountingTask (Atomic<int>& counter_, int target_, WaitableEvent& finished_)
+			:	ProgressiveTask ("Counting task"),
+				counter (counter_),
+				finished (finished_),
+				target (target_)
+		{
+		}
+
+		virtual Result run () override
+		{
+			if (++counter == target)
+				finished.signal ();
+
+			return Result::ok ();
+		}
+
+	private:
+
+		Atomic<int>& counter;
+		WaitableEvent& finished;
+		int target;
+	};
+
+	class Producer	:	public Thread
+	{
+	public:
+
+		Producer (TaskThreadPool& pool_, int numTasks_, Atomic<int>& counter_, int target_, WaitableEvent& finished_)
+			:	Thread ("Benchmark producer"),
+				pool (pool_),
+				counter (counter_),
+				finished (finished_),
+				numTasks (numTasks_),
+				target (target_)
+		{
+		}
+
+		virtual void run () override
+		{
+			for (int i = 0; i < numTasks; ++i)
+				pool.addTask (new CountingTask (counter, target, finished));
+		}
+
+	private:
+
+		TaskThreadPool& pool;
+		Atomic<int>& counter;
+		WaitableEvent& finished;
+		int numTasks;
+		int target;
+	};
+
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif//XH_INCLUDE_BENCHMARKS
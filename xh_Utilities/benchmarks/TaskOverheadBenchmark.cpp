@@ -0,0 +1,336 @@
+#if XH_INCLUDE_BENCHMARKS
+
+///////////////////////////////////////////////////////////////////////////////
+/**
+	Measures the overhead of the task primitives which get used constantly:
+	sub-task round trips, progress and status updates, context creation and
+	TaskThreadPool latency and throughput.
+
+	Each result is logged as a single line of JSON, e.g.
+
+	{"benchmark":"performSubTask","param":"depth=4","value":1.23,"unit":"us/op"}
+
+	so that the output can be collected and compared between versions.
+*/
+///////////////////////////////////////////////////////////////////////////////
+
+class TaskOverheadBenchmark	:	public UnitTest
+{
+public:
+
+	TaskOverheadBenchmark () : UnitTest ("Task overhead") {}
+
+	virtual void runTest ()
+	{
+		beginTest ("performSubTask round trip");
+		{
+			const int depths[] = { 1, 4, 16, 64 };
+
+			for (int i = 0; i < numElementsInArray (depths); ++i)
+				report ("performSubTask", "depth=" + String (depths[i]), measureSubTaskRoundTrip (depths[i]), "us/op");
+		}
+
+		beginTest ("setProgress / setStatusMessage");
+		{
+			const int listenerCounts[] = { 0, 1, 16 };
+
+			for (int i = 0; i < numElementsInArray (listenerCounts); ++i)
+			{
+				const String param ("listeners=" + String (listenerCounts[i]));
+
+				report ("setProgress", param, measureUpdates (listenerCounts[i], false), "us/op");
+				report ("setStatusMessage", param, measureUpdates (listenerCounts[i], true), "us/op");
+			}
+		}
+
+		beginTest ("TaskContext lifetime");
+		{
+			setRecyclingEnabled (false);
+			report ("TaskContext create+destroy", "recycling=0", measureContextLifetime (), "us/op");
+			report ("pool throughput", "recycling=0,workers=1", measureThroughput (TaskThreadPool::workStealingScheduler, 1), "jobs/s");
+
+			setRecyclingEnabled (true);
+			report ("TaskContext create+destroy", "recycling=1", measureContextLifetime (), "us/op");
+			report ("pool throughput", "recycling=1,workers=1", measureThroughput (TaskThreadPool::workStealingScheduler, 1), "jobs/s");
+		}
+
+		beginTest ("TaskThreadPool");
+		{
+			for (int type = 0; type < 2; ++type)
+			{
+				const TaskThreadPool::SchedulerType schedulerType = (type == 0) ? TaskThreadPool::threadPoolScheduler
+																				: TaskThreadPool::workStealingScheduler;
+				const String schedulerName (type == 0 ? "threadPool" : "workStealing");
+
+				for (int numWorkers = 1; numWorkers <= SystemStats::getNumCpus(); numWorkers *= 2)
+				{
+					const String param ("scheduler=" + schedulerName + ",workers=" + String (numWorkers));
+
+					double p50 = 0.0, p99 = 0.0;
+					measureStartLatency (schedulerType, numWorkers, p50, p99);
+
+					report ("pool submit-to-start p50", param, p50, "us");
+					report ("pool submit-to-start p99", param, p99, "us");
+					report ("pool throughput", param, measureThroughput (schedulerType, numWorkers), "jobs/s");
+				}
+			}
+		}
+	}
+
+private:
+
+	//=========================================================================
+
+	class EmptyTask	:	public ProgressiveTask
+	{
+	public:
+		EmptyTask () : ProgressiveTask ("Empty task") {}
+		virtual Result run () override	{ return Result::ok (); }
+	};
+
+	/** Performs a chain of nested sub-tasks, 'depth' levels deep. */
+	class NestedTask	:	public ProgressiveTask
+	{
+	public:
+
+		NestedTask (int depth)
+			:	ProgressiveTask ("Nested task")
+		{
+			if (depth > 1)
+				child = new NestedTask (depth - 1);
+		}
+
+		virtual Result run () override
+		{
+			if (child != nullptr)
+				return performSubTask (*child, 1.0);
+
+			return Result::ok ();
+		}
+
+	private:
+
+		ScopedPointer< NestedTask > child;
+	};
+
+	/** Repeatedly performs a sub-task, and times the whole lot. */
+	class RepeatTask	:	public ProgressiveTask
+	{
+	public:
+
+		RepeatTask (ProgressiveTask* taskToRepeat, int iterations_)
+			:	ProgressiveTask ("Repeat task"),
+				subTask (taskToRepeat),
+				iterations (iterations_),
+				seconds (0.0)
+		{
+		}
+
+		virtual Result run () override
+		{
+			const int64 start = Time::getHighResolutionTicks ();
+
+			for (int i = 0; i < iterations; ++i)
+				performSubTask (*subTask, 0.0);
+
+			seconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks () - start);
+			return Result::ok ();
+		}
+
+		ScopedPointer< ProgressiveTask > subTask;
+		const int iterations;
+		double seconds;
+	};
+
+	/** Repeatedly calls setProgress or setStatusMessage, and times it. */
+	class UpdateTask	:	public ProgressiveTask
+	{
+	public:
+
+		UpdateTask (int iterations_, bool statusMessages_)
+			:	ProgressiveTask ("Update task"),
+				iterations (iterations_),
+				statusMessages (statusMessages_),
+				seconds (0.0)
+		{
+		}
+
+		virtual Result run () override
+		{
+			const String message ("Working");
+			const int64 start = Time::getHighResolutionTicks ();
+
+			for (int i = 0; i < iterations; ++i)
+			{
+				if (statusMessages)
+					setStatusMessage (message);
+				else
+					setProgress ((double) i / iterations);
+			}
+
+			seconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks () - start);
+			return Result::ok ();
+		}
+
+		const int iterations;
+		const bool statusMessages;
+		double seconds;
+	};
+
+	class NullListener	:	public TaskContext::Listener
+	{
+	public:
+		virtual void taskStatusMessageChanged (TaskContext&) override	{}
+		virtual void taskProgressChanged (TaskContext&) override		{}
+	};
+
+	/** Records when it starts running. */
+	class TimedTask	:	public ProgressiveTask
+	{
+	public:
+
+		TimedTask (WaitableEvent& started_, int64& startTicks_)
+			:	ProgressiveTask ("Timed task"),
+				started (started_),
+				startTicks (startTicks_)
+		{
+		}
+
+		virtual Result run () override
+		{
+			startTicks = Time::getHighResolutionTicks ();
+			started.signal ();
+			return Result::ok ();
+		}
+
+	private:
+
+		WaitableEvent& started;
+		int64& startTicks;
+	};
+
+	//=========================================================================
+
+	/** The contexts created here are deleted (and their callbacks run) on the
+		calling thread, so that the measurements include that work, and don't
+		depend on a message loop. */
+	InlineTaskDispatcher dispatcher;
+
+	void report (const String& benchmark, const String& param, double value, const String& unit)
+	{
+		DynamicObject::Ptr result (new DynamicObject ());
+		result->setProperty ("benchmark", benchmark);
+		result->setProperty ("param", param);
+		result->setProperty ("value", value);
+		result->setProperty ("unit", unit);
+
+		logMessage (JSON::toString (var (result), true));
+	}
+
+	static void setRecyclingEnabled (bool shouldBeEnabled)
+	{
+		RecyclingAllocator< sizeof (TaskContext) >::setEnabled (shouldBeEnabled);
+		RecyclingAllocator< sizeof (TaskThreadPool::Job) >::setEnabled (shouldBeEnabled);
+		TaskWorkAllocator::setEnabled (shouldBeEnabled);
+	}
+
+	static double toMicroseconds (double seconds, int iterations)
+	{
+		return iterations > 0 ? (seconds * 1.0e6) / iterations : 0.0;
+	}
+
+	double measureSubTaskRoundTrip (int depth)
+	{
+		const int iterations = 20000 / depth;
+
+		RepeatTask* task = new RepeatTask (new NestedTask (depth), iterations);
+		TaskContext::Ptr context (new TaskContext (task));
+		context->setDispatcher (dispatcher);
+
+		InlineTaskRunner runner;
+		runner.runTask (context);
+
+		return toMicroseconds (task->seconds, iterations);
+	}
+
+	double measureUpdates (int numListeners, bool statusMessages)
+	{
+		const int iterations = 100000;
+
+		UpdateTask* task = new UpdateTask (iterations, statusMessages);
+		TaskContext::Ptr context (new TaskContext (task));
+		context->setDispatcher (dispatcher);
+
+		OwnedArray< NullListener > listeners;
+		for (int i = 0; i < numListeners; ++i)
+			context->addListener (listeners.add (new NullListener ()));
+
+		InlineTaskRunner runner;
+		runner.runTask (context);
+
+		for (int i = 0; i < listeners.size(); ++i)
+			context->removeListener (listeners.getUnchecked (i));
+
+		return toMicroseconds (task->seconds, iterations);
+	}
+
+	double measureContextLifetime ()
+	{
+		const int iterations = 20000;
+		const int64 start = Time::getHighResolutionTicks ();
+
+		for (int i = 0; i < iterations; ++i)
+		{
+			TaskContext::Ptr context (new TaskContext (new EmptyTask ()));
+			context->setDispatcher (dispatcher);
+		}
+
+		return toMicroseconds (Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks () - start), iterations);
+	}
+
+	void measureStartLatency (TaskThreadPool::SchedulerType type, int numWorkers, double& p50, double& p99)
+	{
+		const int iterations = 1000;
+
+		TaskThreadPool pool (numWorkers, type);
+		WaitableEvent started;
+		Array< double > latencies;
+
+		for (int i = 0; i < iterations; ++i)
+		{
+			int64 startTicks = 0;
+			const int64 submitTicks = Time::getHighResolutionTicks ();
+
+			pool.addTask (new TimedTask (started, startTicks));
+
+			if (! started.wait (5000))
+				break;
+
+			latencies.add (Time::highResolutionTicksToSeconds (startTicks - submitTicks) * 1.0e6);
+		}
+
+		expectEquals (latencies.size(), iterations);
+
+		latencies.sort ();
+		p50 = latencies.size() > 0 ? latencies [(latencies.size() - 1) / 2] : 0.0;
+		p99 = latencies.size() > 0 ? latencies [(int) (0.99 * (latencies.size() - 1))] : 0.0;
+	}
+
+	double measureThroughput (TaskThreadPool::SchedulerType type, int numWorkers)
+	{
+		const int numTasks = 20000;
+
+		int numCompleted = 0;
+		const double rate = PoolThroughput::measure (type, numWorkers, 0, numTasks, numCompleted);
+
+		expectEquals (numCompleted, numTasks);
+		return rate;
+	}
+
+};
+
+static TaskOverheadBenchmark taskOverheadBenchmark;
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif//XH_INCLUDE_BENCHMARKS
@@ -0,0 +1,157 @@
+#if XH_INCLUDE_BENCHMARKS
+
+///////////////////////////////////////////////////////////////////////////////
+/**
+	Measures how long high priority tasks wait in a TaskThreadPool's queue
+	while it is saturated with low priority work. With priority lanes, the
+	high lane's 99th percentile wait should stay roughly flat however much
+	low priority work is queued.
+*/
+///////////////////////////////////////////////////////////////////////////////
+
+class TaskPriorityBenchmark	:	public UnitTest
+{
+public:
+
+	TaskPriorityBenchmark () : UnitTest ("TaskThreadPool priority lanes") {}
+
+	virtual void runTest ()
+	{
+		const int numWorkers = jmax (2, SystemStats::getNumCpus() / 2);
+
+		for (int numLowTasks = 1000; numLowTasks <= 8000; numLowTasks *= 2)
+		{
+			beginTest ("Low priority tasks: " + String (numLowTasks));
+
+			measureQueueWait ("workStealingScheduler", TaskThreadPool::workStealingScheduler, numWorkers, numLowTasks);
+			measureQueueWait ("threadPoolScheduler", TaskThreadPool::threadPoolScheduler, numWorkers, numLowTasks);
+		}
+
+		beginTest ("Saturated low lane");
+		{
+			// Enough low priority work that the whole backlog is older than
+			// the aging time long before it has been run; aging must not let
+			// it hold up the high lane.
+			const int numLowTasks = 2000 * numWorkers;
+
+			double highP99 = 0.0, lowP99 = 0.0;
+			measureQueueWait ("workStealingScheduler (saturated)", TaskThreadPool::workStealingScheduler,
+							  numWorkers, numLowTasks, &highP99, &lowP99);
+
+			expect (lowP99 > 100.0, "The low lane wasn't saturated");
+			expect (highP99 < lowP99 * 0.1, "High lane p99 wait of " + String (highP99, 2) + " ms is too long");
+		}
+	}
+
+private:
+
+	class WaitTimes
+	{
+	public:
+
+		WaitTimes (int target_) : target (target_) {}
+
+		void add (TaskThreadPool::Priority priority, double waitMs)
+		{
+			{
+				const ScopedLock sl (lock);
+
+				if (priority == TaskThreadPool::highPriority)
+					highWaits.add (waitMs);
+				else
+					lowWaits.add (waitMs);
+			}
+
+			if (++count == target)
+				finished.signal ();
+		}
+
+		static double getPercentile (Array< double > waits, double percentile)
+		{
+			if (waits.size() == 0)
+				return 0.0;
+
+			waits.sort ();
+			return waits [(int) (percentile * (waits.size() - 1))];
+		}
+
+		CriticalSection lock;
+		Array< double > highWaits;
+		Array< double > lowWaits;
+		Atomic< int > count;
+		WaitableEvent finished;
+		const int target;
+	};
+
+	class WaitingTask	:	public ProgressiveTask
+	{
+	public:
+
+		WaitingTask (WaitTimes& waitTimes_, TaskThreadPool::Priority priority_, double busyMs_)
+			:	ProgressiveTask ("Waiting task"),
+				waitTimes (waitTimes_),
+				priority (priority_),
+				busyMs (busyMs_),
+				timeQueued (Time::getMillisecondCounterHiRes ())
+		{
+		}
+
+		virtual Result run () override
+		{
+			const double start = Time::getMillisecondCounterHiRes ();
+			waitTimes.add (priority, start - timeQueued);
+
+			// Keep the worker busy for a while, as a real job would.
+			while (Time::getMillisecondCounterHiRes () - start < busyMs)
+			{
+			}
+
+			return Result::ok ();
+		}
+
+	private:
+
+		WaitTimes& waitTimes;
+		const TaskThreadPool::Priority priority;
+		const double busyMs;
+		const double timeQueued;
+	};
+
+	void measureQueueWait (const String& name, TaskThreadPool::SchedulerType type, int numWorkers, int numLowTasks,
+						   double* highP99 = nullptr, double* lowP99 = nullptr)
+	{
+		const int numHighTasks = 200;
+
+		TaskThreadPool pool (numWorkers, type);
+		WaitTimes waitTimes (numLowTasks + numHighTasks);
+
+		for (int i = 0; i < numLowTasks; ++i)
+			pool.addTask (new WaitingTask (waitTimes, TaskThreadPool::lowPriority, 0.2), Identifier::null, TaskThreadPool::lowPriority);
+
+		for (int i = 0; i < numHighTasks; ++i)
+		{
+			pool.addTask (new WaitingTask (waitTimes, TaskThreadPool::highPriority, 0.05), Identifier::null, TaskThreadPool::highPriority);
+			Thread::sleep (1);
+		}
+
+		expect (waitTimes.finished.wait (120000), "Timed out waiting for tasks");
+
+		const ScopedLock sl (waitTimes.lock);
+
+		const double high = WaitTimes::getPercentile (waitTimes.highWaits, 0.99);
+		const double low = WaitTimes::getPercentile (waitTimes.lowWaits, 0.99);
+
+		logMessage (name + ": high lane p99 wait " + String (high, 2) + " ms, "
+				  + "low lane p99 wait " + String (low, 2) + " ms");
+
+		if (highP99 != nullptr)	*highP99 = high;
+		if (lowP99 != nullptr)	*lowP99 = low;
+	}
+
+};
+
+static TaskPriorityBenchmark taskPriorityBenchmark;
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif//XH_INCLUDE_BENCHMARKS
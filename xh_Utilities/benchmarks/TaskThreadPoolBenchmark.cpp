@@ -0,0 +1,51 @@
+#if XH_INCLUDE_BENCHMARKS
+
+///////////////////////////////////////////////////////////////////////////////
+/**
+	Measures how many short tasks per second a TaskThreadPool can get through
+	when they are added from several producer threads at once, comparing the
+	juce::ThreadPool scheduler against the work-stealing one.
+*/
+///////////////////////////////////////////////////////////////////////////////
+
+class TaskThreadPoolBenchmark	:	public UnitTest
+{
+public:
+
+	TaskThreadPoolBenchmark () : UnitTest ("TaskThreadPool throughput") {}
+
+	virtual void runTest ()
+	{
+		const int numTasks = 20000;
+		const int numProducers = 4;
+
+		for (int numWorkers = 1; numWorkers <= SystemStats::getNumCpus(); numWorkers *= 2)
+		{
+			beginTest ("Workers: " + String (numWorkers));
+
+			const double poolRate = measureThroughput (TaskThreadPool::threadPoolScheduler, numWorkers, numProducers, numTasks);
+			const double stealingRate = measureThroughput (TaskThreadPool::workStealingScheduler, numWorkers, numProducers, numTasks);
+
+			logMessage ("threadPoolScheduler:   " + String (poolRate, 0) + " tasks/sec");
+			logMessage ("workStealingScheduler: " + String (stealingRate, 0) + " tasks/sec");
+		}
+	}
+
+private:
+
+	double measureThroughput (TaskThreadPool::SchedulerType type, int numWorkers, int numProducers, int numTasks)
+	{
+		int numCompleted = 0;
+		const double rate = PoolThroughput::measure (type, numWorkers, numProducers, numTasks, numCompleted);
+
+		expectEquals (numCompleted, PoolThroughput::getNumTasksToRun (numProducers, numTasks));
+		return rate;
+	}
+
+};
+
+static TaskThreadPoolBenchmark taskThreadPoolBenchmark;
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif//XH_INCLUDE_BENCHMARKS
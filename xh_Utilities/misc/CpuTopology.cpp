@@ -0,0 +1,247 @@
+
+///////////////////////////////////////////////////////////////////////////////
+
+CpuTopology::CpuTopology ()
+{
+	readFromSystem ();
+
+	if (cpus.size() == 0)
+	{
+		for (int i = 0; i < SystemStats::getNumCpus (); ++i)
+		{
+			Cpu cpu = { i, 0, i };
+			cpus.add (cpu);
+			allCpus.setBit (i);
+		}
+	}
+}
+
+CpuTopology::~CpuTopology ()
+{
+	for (HashMap< int, Array< BigInteger >* >::Iterator i (cacheSets); i.next();)
+		delete i.getValue ();
+}
+
+const CpuTopology& CpuTopology::getSystemTopology ()
+{
+	static CpuTopology topology;
+	return topology;
+}
+
+int CpuTopology::getNumCpus () const
+{
+	return cpus.size();
+}
+
+const BigInteger& CpuTopology::getAllCpus () const
+{
+	return allCpus;
+}
+
+Array< BigInteger > CpuTopology::getPackageCpuSets () const
+{
+	HashMap< int, int > packageIndices;
+	Array< BigInteger > sets;
+
+	for (int i = 0; i < cpus.size(); ++i)
+	{
+		const Cpu& cpu = cpus.getReference (i);
+
+		if (! packageIndices.contains (cpu.package))
+		{
+			packageIndices.set (cpu.package, sets.size());
+			sets.add (BigInteger ());
+		}
+
+		sets.getReference (packageIndices [cpu.package]).setBit (cpu.index);
+	}
+
+	return sets;
+}
+
+Array< BigInteger > CpuTopology::getCoreCpuSets () const
+{
+	// Core ids are only unique within a package.
+	HashMap< String, int > coreIndices;
+	Array< BigInteger > sets;
+
+	for (int i = 0; i < cpus.size(); ++i)
+	{
+		const Cpu& cpu = cpus.getReference (i);
+		const String key (String (cpu.package) + ":" + String (cpu.core));
+
+		if (! coreIndices.contains (key))
+		{
+			coreIndices.set (key, sets.size());
+			sets.add (BigInteger ());
+		}
+
+		sets.getReference (coreIndices [key]).setBit (cpu.index);
+	}
+
+	return sets;
+}
+
+Array< BigInteger > CpuTopology::getNumaNodeCpuSets () const
+{
+	if (nodeSets.size() > 0)
+		return nodeSets;
+
+	return getPackageCpuSets ();
+}
+
+Array< BigInteger > CpuTopology::getSharedCacheCpuSets (int cacheLevel) const
+{
+	const Array< BigInteger >* sets = cacheSets [cacheLevel];
+
+	if (sets != nullptr)
+		return *sets;
+
+	return getPackageCpuSets ();
+}
+
+BigInteger CpuTopology::parseCpuList (const String& cpuList)
+{
+	BigInteger result;
+
+	StringArray ranges;
+	ranges.addTokens (cpuList.trim (), ",", String::empty);
+
+	for (int i = 0; i < ranges.size(); ++i)
+	{
+		const String range (ranges[i].trim ());
+		if (range.isEmpty ())
+			continue;
+
+		const int first = range.upToFirstOccurrenceOf ("-", false, false).getIntValue ();
+		const int last = range.containsChar ('-') ? range.fromFirstOccurrenceOf ("-", false, false).getIntValue ()
+												  : first;
+
+		for (int cpu = first; cpu <= last; ++cpu)
+			result.setBit (cpu);
+	}
+
+	return result;
+}
+
+bool CpuTopology::setCurrentThreadAffinity (const BigInteger& cpuSet)
+{
+	if (cpuSet.isZero ())
+		return false;
+
+   #if JUCE_LINUX || JUCE_ANDROID
+	cpu_set_t set;
+	CPU_ZERO (&set);
+
+	for (int cpu = cpuSet.findNextSetBit (0); cpu >= 0; cpu = cpuSet.findNextSetBit (cpu + 1))
+	{
+		if (cpu < CPU_SETSIZE)
+			CPU_SET (cpu, &set);
+	}
+
+	// A pid of 0 means the calling thread.
+	return sched_setaffinity (0, sizeof (set), &set) == 0;
+   #else
+	if (cpuSet.getHighestBit () >= 32)
+		return false;
+
+	Thread::setCurrentThreadAffinityMask (cpuSet.getBitRangeAsInt (0, 32));
+	return true;
+   #endif
+}
+
+void CpuTopology::addUniqueSet (Array< BigInteger >& sets, const BigInteger& cpuSet) const
+{
+	if (! cpuSet.isZero () && ! sets.contains (cpuSet))
+		sets.add (cpuSet);
+}
+
+void CpuTopology::readFromSystem ()
+{
+   #if JUCE_LINUX || JUCE_ANDROID
+	const File cpuRoot ("/sys/devices/system/cpu");
+
+	allCpus = parseCpuList (cpuRoot.getChildFile ("online").loadFileAsString ());
+
+	for (int index = allCpus.findNextSetBit (0); index >= 0; index = allCpus.findNextSetBit (index + 1))
+	{
+		const File cpuDir (cpuRoot.getChildFile ("cpu" + String (index)));
+		const File topology (cpuDir.getChildFile ("topology"));
+
+		Cpu cpu = { index, 0, index };
+
+		if (topology.isDirectory ())
+		{
+			cpu.package = topology.getChildFile ("physical_package_id").loadFileAsString ().getIntValue ();
+			cpu.core = topology.getChildFile ("core_id").loadFileAsString ().getIntValue ();
+		}
+
+		cpus.add (cpu);
+
+		// Each cache lists all of the CPUs which share it.
+		Array< File > caches;
+		cpuDir.getChildFile ("cache").findChildFiles (caches, File::findDirectories, false, "index*");
+
+		for (int i = 0; i < caches.size(); ++i)
+		{
+			const int level = caches.getReference (i).getChildFile ("level").loadFileAsString ().getIntValue ();
+			const BigInteger shared (parseCpuList (caches.getReference (i).getChildFile ("shared_cpu_list").loadFileAsString ()));
+
+			if (level <= 0)
+				continue;
+
+			Array< BigInteger >* sets = cacheSets [level];
+			if (sets == nullptr)
+			{
+				sets = new Array< BigInteger > ();
+				cacheSets.set (level, sets);
+			}
+
+			addUniqueSet (*sets, shared & allCpus);
+		}
+	}
+
+	Array< File > nodes;
+	File ("/sys/devices/system/node").findChildFiles (nodes, File::findDirectories, false, "node*");
+
+	for (int i = 0; i < nodes.size(); ++i)
+	{
+		const BigInteger nodeCpus (parseCpuList (nodes.getReference (i).getChildFile ("cpulist").loadFileAsString ()));
+		addUniqueSet (nodeSets, nodeCpus & allCpus);
+	}
+   #endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+class CpuTopologyTests	:	public UnitTest
+{
+public:
+
+	CpuTopologyTests () : UnitTest ("CpuTopology") {}
+
+	virtual void runTest ()
+	{
+		beginTest ("Parsing CPU lists");
+
+		// As read from sysfs, with a trailing newline.
+		const BigInteger cpus (CpuTopology::parseCpuList ("0-3,8,10-11\n"));
+
+		expectEquals (cpus.countNumberOfSetBits (), 7);
+		expectEquals (cpus.getHighestBit (), 11);
+
+		for (int i = 0; i <= 3; ++i)
+			expect (cpus [i]);
+
+		expect (! cpus [4] && ! cpus [7] && ! cpus [9]);
+		expect (cpus [8] && cpus [10] && cpus [11]);
+
+		expect (CpuTopology::parseCpuList (" 5 ") == BigInteger (32));
+		expect (CpuTopology::parseCpuList ("2,,3") == BigInteger (12));
+		expect (CpuTopology::parseCpuList (String::empty).isZero ());
+	}
+};
+
+static CpuTopologyTests cpuTopologyTests;
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,84 @@
+#ifndef CPUTOPOLOGY_H_INCLUDED
+#define CPUTOPOLOGY_H_INCLUDED
+
+///////////////////////////////////////////////////////////////////////////////
+/**
+	Describes how the machine's logical CPUs are arranged into cores,
+	packages (sockets), NUMA nodes and shared caches, so that work can be
+	kept on CPUs which share the same caches and memory.
+
+	Sets of CPUs are represented as BigIntegers, with bit n set for logical
+	CPU n (so there's no limit on the number of CPUs, unlike the uint32
+	masks used by juce::Thread).
+
+	On Linux, the layout is read from /sys/devices/system/cpu and
+	/sys/devices/system/node. Elsewhere (or if those can't be read), every
+	CPU is assumed to be a separate core in a single package, with no
+	shared caches.
+*/
+///////////////////////////////////////////////////////////////////////////////
+
+class CpuTopology
+{
+public:
+
+	/** Reads the layout of the machine this is running on. */
+	CpuTopology ();
+	~CpuTopology ();
+
+	/** Returns the layout of this machine. It is only read once. */
+	static const CpuTopology& getSystemTopology ();
+
+	/** Returns the number of logical CPUs which are online. */
+	int getNumCpus () const;
+
+	/** Returns all of the online CPUs. */
+	const juce::BigInteger& getAllCpus () const;
+
+	/** Returns one set of CPUs per physical package (socket). */
+	juce::Array< juce::BigInteger > getPackageCpuSets () const;
+
+	/** Returns one set of CPUs per physical core, i.e. the hyperthreads
+		which share a core. */
+	juce::Array< juce::BigInteger > getCoreCpuSets () const;
+
+	/** Returns one set of CPUs per NUMA node. Without NUMA information, this
+		is the same as getPackageCpuSets(). */
+	juce::Array< juce::BigInteger > getNumaNodeCpuSets () const;
+
+	/** Returns the groups of CPUs which share a cache at the given level
+		(e.g. 3 for the L3 caches). Without any cache information, this
+		returns the package sets instead. */
+	juce::Array< juce::BigInteger > getSharedCacheCpuSets (int cacheLevel) const;
+
+	/** Parses a Linux-style CPU list, such as "0-3,8,10-11". */
+	static juce::BigInteger parseCpuList (const juce::String& cpuList);
+
+	/** Restricts the calling thread to the given CPUs. If the platform can't
+		do this (or the set is empty), it returns false and the thread is
+		left as it was. */
+	static bool setCurrentThreadAffinity (const juce::BigInteger& cpus);
+
+private:
+
+	struct Cpu
+	{
+		int index;
+		int package;
+		int core;
+	};
+
+	void readFromSystem ();
+	void addUniqueSet (juce::Array< juce::BigInteger >& sets, const juce::BigInteger& cpus) const;
+
+	juce::Array< Cpu > cpus;
+	juce::BigInteger allCpus;
+	juce::Array< juce::BigInteger > nodeSets;
+	juce::HashMap< int, juce::Array< juce::BigInteger >* > cacheSets;	// by cache level
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CpuTopology);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif  // CPUTOPOLOGY_H_INCLUDED
@@ -0,0 +1,61 @@
+
+///////////////////////////////////////////////////////////////////////////////
+
+CancellationToken::CancellationToken ()
+	:	parent (nullptr)
+{
+}
+
+CancellationToken::~CancellationToken ()
+{
+	setParent (nullptr);
+
+	// Any tokens linked beneath this one should have been unlinked first!
+	jassert (children.size() == 0);
+}
+
+void CancellationToken::cancel ()
+{
+	if (! cancelled.compareAndSetBool (1, 0))
+		return;
+
+	// The children are cancelled with our lock held, so none of them can
+	// unlink (and be deleted) while we're doing it. Locks are always taken
+	// from the top of the tree down, so this can't deadlock.
+	const SpinLock::ScopedLockType sl (lock);
+
+	for (int i = 0; i < children.size(); ++i)
+		children.getUnchecked (i)->cancel ();
+}
+
+void CancellationToken::setParent (CancellationToken* newParent)
+{
+	jassert (newParent != this);
+
+	if (newParent == parent)
+		return;
+
+	if (parent != nullptr)
+		parent->removeChild (this);
+
+	parent = newParent;
+
+	if (parent != nullptr)
+	{
+		const SpinLock::ScopedLockType sl (parent->lock);
+		parent->children.add (this);
+
+		// If the parent was cancelled before we were added, it won't have
+		// seen us, so the cancellation is passed on here instead.
+		if (parent->isCancelled ())
+			cancel ();
+	}
+}
+
+void CancellationToken::removeChild (CancellationToken* child)
+{
+	const SpinLock::ScopedLockType sl (lock);
+	children.removeFirstMatchingValue (child);
+}
+
+///////////////////////////////////////////////////////////////////////////////
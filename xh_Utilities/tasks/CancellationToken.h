@@ -0,0 +1,56 @@
+#ifndef CANCELLATIONTOKEN_H_INCLUDED
+#define CANCELLATIONTOKEN_H_INCLUDED
+
+///////////////////////////////////////////////////////////////////////////////
+/**
+	A flag which can be set from any thread to ask a piece of work to stop.
+
+	Tokens can be linked into a tree, so that cancelling a token immediately
+	cancels all of the tokens linked beneath it (but not the one above it).
+	The cancellation is pushed down the tree when it happens, so checking
+	isCancelled() is just a single read of the token's own flag, which is
+	cheap enough to be called from within a tight loop.
+
+	A token can only be cancelled once; there is no way to reset it.
+*/
+///////////////////////////////////////////////////////////////////////////////
+
+class CancellationToken
+{
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CancellationToken);
+public:
+
+	CancellationToken ();
+	~CancellationToken ();
+
+	/** Cancels this token, along with all of the tokens linked beneath it.
+		This is safe to call from any thread. */
+	void cancel ();
+
+	/** Returns true if this token (or one above it) has been cancelled. */
+	bool isCancelled () const noexcept
+	{
+		// A plain read of the flag; a cancel from another thread only needs
+		// to be seen eventually, not in any particular order.
+		return cancelled.value != 0;
+	}
+
+	/** Links this token beneath another one (or unlinks it, if this is
+		null). If the new parent has already been cancelled, this token is
+		cancelled straight away. The parent must outlive the link. */
+	void setParent (CancellationToken* newParent);
+
+private:
+
+	void removeChild (CancellationToken* child);
+
+	juce::Atomic< int > cancelled;
+	CancellationToken* parent;
+	juce::SpinLock lock;
+	juce::Array< CancellationToken* > children;	// guarded by lock
+	
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif//CANCELLATIONTOKEN_H_INCLUDED
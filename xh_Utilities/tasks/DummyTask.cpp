@@ -2,8 +2,9 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 DummyTask::DummyTask (const String& taskName, double durationInSeconds)
-	:	ProgressiveTask (taskName),
-		duration (RelativeTime::seconds(durationInSeconds))
+	:	ResumableTask (taskName),
+		duration (RelativeTime::seconds(durationInSeconds)),
+		started (false)
 {
 }
 
@@ -11,31 +12,46 @@ DummyTask::~DummyTask ()
 {
 }
 
-Result DummyTask::run ()
+ResumableTask::Step DummyTask::resume ()
 {
 	if (duration.inSeconds() < 0.0)
-		return Result::ok ();
+		return Step::finished ();
 
-	Time startTime = Time::getCurrentTime();
-    
-    setStatusMessage(getName());
-
-	while (elapsed < duration)
+	if (! started)
 	{
-		elapsed = Time::getCurrentTime () - startTime;
+		started = true;
+		startTime = Time::getCurrentTime();
+		setStatusMessage(getName());
+	}
 
-		if (shouldAbort())
-			return Result::ok();
+	elapsed = Time::getCurrentTime () - startTime;
 
-		double progress = 1.0;
-		if (duration.inSeconds() > 0)
-			progress = elapsed.inSeconds() / duration.inSeconds();
-		setProgress(progress);
+	if (shouldAbort())
+		return finish ();
 
-		Thread::sleep (50);
-	}
+	double progress = 1.0;
+	if (duration.inSeconds() > 0)
+		progress = elapsed.inSeconds() / duration.inSeconds();
+	setProgress(progress);
+
+	if (elapsed < duration)
+		return Step::sleep (50);
+
+	return finish ();
+}
 
-	return Result::ok ();
+Result DummyTask::getAbortResult ()
+{
+	// This is used when the task is aborted between steps, in which case
+	// resume() isn't called again.
+	started = false;
+	return ResumableTask::getAbortResult ();
+}
+
+ResumableTask::Step DummyTask::finish ()
+{
+	started = false;
+	return Step::finished ();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -3,11 +3,13 @@
 
 ///////////////////////////////////////////////////////////////////////////////
 /**
-	A dummy Task that simply waits for a specified amount of time.
+	A dummy Task that simply waits for a specified amount of time. It checks
+	the time every 50ms; on a TaskThreadPool, it doesn't hold a worker in
+	between.
 */
 ///////////////////////////////////////////////////////////////////////////////
 
-class DummyTask	:	public ProgressiveTask
+class DummyTask	:	public ResumableTask
 {
 	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DummyTask);
 public:
@@ -21,12 +23,19 @@ public:
     
 	virtual ~DummyTask ();
 
-	virtual juce::Result run ();
+	virtual Step resume () override;
+
+	/** Makes sure that the task starts from scratch if it's run again. */
+	virtual juce::Result getAbortResult () override;
     
 private:
+
+	Step finish ();
 	
     juce::RelativeTime duration;
 	juce::RelativeTime elapsed;
+	juce::Time startTime;
+	bool started;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
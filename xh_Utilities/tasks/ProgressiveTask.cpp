@@ -8,17 +8,23 @@ public:
 		:	owner(context)
 	{
 		jassert (threadBase.isCurrentTaskThread());
-		ScopedLock lock (owner.runtimeLock);
 
-		owner.taskThread = &threadBase;
+		{
+			ScopedLock lock (owner.runtimeLock);
+			owner.taskThread = &threadBase;
+		}
+
+		// The state changes are made without holding the lock, as they call
+		// the context's listeners.
+		owner.publishProgress (0.0);
 		owner.setState (taskStarting);
 	}
 
 	~ScopedRunTime ()
 	{
-		ScopedLock lock (owner.runtimeLock);
-
 		owner.setState (taskCompleted);
+
+		ScopedLock lock (owner.runtimeLock);
 		owner.taskThread = nullptr;
 	}
 
@@ -29,21 +35,188 @@ private:
 
 ///////////////////////////////////////////////////////////////////////////////
 
+/** A registered listener. Entries are shared between listener snapshots, so
+	one which has been removed may still be reached from an older snapshot;
+	it is marked as removed, and simply ignores any further calls. */
+class TaskContext::ListenerEntry	:	public ReferenceCountedObject
+{
+	JUCE_DECLARE_NON_COPYABLE (ListenerEntry);
+public:
+
+	typedef ReferenceCountedObjectPtr< ListenerEntry > Ptr;
+
+	ListenerEntry (Listener* listener_, const NotificationPolicy& policy_)
+		:	listener (listener_),
+			policy (policy_),
+			lastProgress (0.0),
+			lastProgressTime (0.0),
+			lastStatusMessageTime (0.0),
+			progressPending (false),
+			statusMessagePending (false)
+	{
+	}
+
+	void call (ListenerCallback callback, TaskContext& context)
+	{
+		ScopedLock sl (callLock);
+
+		if (removed.get() == 0)
+			(listener->*callback) (context);
+	}
+
+	void notifyProgressChanged (TaskContext& context, double progress, double now)
+	{
+		ScopedLock sl (callLock);
+
+		if (removed.get() == 0 && progressChanged (progress, now))
+			listener->taskProgressChanged (context);
+	}
+
+	void notifyStatusMessageChanged (TaskContext& context, double now)
+	{
+		ScopedLock sl (callLock);
+
+		if (removed.get() == 0 && statusMessageChanged (now))
+			listener->taskStatusMessageChanged (context);
+	}
+
+	/** Passes on any changes held back by the notification policy. */
+	void flushPendingNotifications (TaskContext& context, double progress, double now)
+	{
+		ScopedLock sl (callLock);
+
+		if (removed.get() == 0 && progressPending)
+		{
+			progressPending = false;
+			lastProgress = progress;
+			lastProgressTime = now;
+			listener->taskProgressChanged (context);
+		}
+
+		if (removed.get() == 0 && statusMessagePending)
+		{
+			statusMessagePending = false;
+			lastStatusMessageTime = now;
+			listener->taskStatusMessageChanged (context);
+		}
+	}
+
+	/** Stops any further calls to the listener. If it is being called on
+		another thread, this waits for that call to return (a listener may
+		safely remove itself from within a callback, though). The wait will
+		deadlock if that callback is itself waiting on the calling thread,
+		which is why TaskContext::removeListener() forbids it. */
+	void markRemoved ()
+	{
+		removed.set (1);
+		ScopedLock sl (callLock);
+	}
+
+	Listener* const listener;
+
+private:
+
+	/** Returns true if the listener should be told about the progress change
+		now, or otherwise remembers that it is pending (if coalescing). */
+	bool progressChanged (double progress, double now)
+	{
+		const bool tooSoon = isTooSoon (lastProgressTime, now);
+		const bool tooSmall = std::abs (progress - lastProgress) < policy.minProgressDelta
+								&& progress > 0.0 && progress < 1.0;
+
+		if (tooSoon || tooSmall)
+		{
+			progressPending = policy.coalesce;
+			return false;
+		}
+
+		lastProgress = progress;
+		lastProgressTime = now;
+		progressPending = false;
+		return true;
+	}
+
+	bool statusMessageChanged (double now)
+	{
+		if (isTooSoon (lastStatusMessageTime, now))
+		{
+			statusMessagePending = policy.coalesce;
+			return false;
+		}
+
+		lastStatusMessageTime = now;
+		statusMessagePending = false;
+		return true;
+	}
+
+	const NotificationPolicy policy;
+	double lastProgress;
+	double lastProgressTime;
+	double lastStatusMessageTime;
+	bool progressPending;
+	bool statusMessagePending;
+	Atomic< int > removed;
+	CriticalSection callLock;
+
+	bool isTooSoon (double lastTime, double now) const
+	{
+		return policy.maxRateHz > 0.0 && (now - lastTime) < (1000.0 / policy.maxRateHz);
+	}
+};
+
+/** An immutable list of listeners. Adding or removing a listener replaces
+	the context's snapshot with a new one, so a notification only holds a
+	spin lock for long enough to pick up a reference to the current one. */
+class TaskContext::ListenerSnapshot	:	public ReferenceCountedObject
+{
+public:
+
+	typedef ReferenceCountedObjectPtr< ListenerSnapshot > Ptr;
+
+	ListenerSnapshot () {}
+
+	ReferenceCountedArray< ListenerEntry > entries;
+
+	JUCE_DECLARE_NON_COPYABLE (ListenerSnapshot);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+TaskContext::NotificationPolicy::NotificationPolicy (double maxRateHz_, double minProgressDelta_, bool coalesce_)
+	:	maxRateHz (maxRateHz_),
+		minProgressDelta (minProgressDelta_),
+		coalesce (coalesce_)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 TaskContext::TaskContext (ProgressiveTask* taskToRun)
 	:	activeTask (taskToRun),
+		dispatcher (&TaskDispatcher::getDefault ()),
 		taskThread (nullptr),
 		result (Result::ok()),
-		currentState (taskPending)
+		predecessorResult (Result::ok()),
+		currentState (taskPending),
+		suspended (false),
+		suspendedProgress (0.0),
+		resultCache (nullptr),
+		resultCacheChecked (false),
+		resultWasCached (false),
+		checkpointFile (File::nonexistent),
+		timeoutMs (-1),
+		overallStatusMessageStamp (0)
 {
 }
 
 TaskContext::~TaskContext ()
 {
-	// This should always be destroyed from the message thread...
-	jassert (MessageManager::getInstance()->isThisTheMessageThread());
+	// This should always be destroyed by its dispatcher...
+	jassert (dispatcher->isDispatchThread());
 	// ... and it should not still be getting executed!
 	jassert (taskThread == nullptr);
 
+	stopDeadline ();
 	flush ();
 }
 
@@ -52,19 +225,65 @@ void TaskContext::addCallback (ProgressiveTask::Callback* callback)
 	callbacks.add (callback);
 }
 
+void TaskContext::setDispatcher (TaskDispatcher& newDispatcher)
+{
+	jassert (currentState == taskPending);
+	dispatcher = &newDispatcher;
+}
+
+TaskDispatcher& TaskContext::getDispatcher () const
+{
+	return *dispatcher;
+}
+
+void TaskContext::destroy (TaskContext* context)
+{
+	if (context != nullptr)
+		context->dispatcher->deleteContext (context);
+}
+
+typedef RecyclingAllocator< sizeof (TaskContext) > TaskContextAllocator;
+
+void* TaskContext::operator new (size_t size)
+{
+	return TaskContextAllocator::allocate (size);
+}
+
+void TaskContext::operator delete (void* block, size_t size)
+{
+	TaskContextAllocator::deallocate (block, size);
+}
+
 ProgressiveTask& TaskContext::getTask ()
 {
 	return *activeTask;
 }
 
+void TaskContext::setId (const Identifier& newId)
+{
+	id = newId;
+}
+
+Identifier TaskContext::getId () const
+{
+	return id;
+}
+
 juce::Result TaskContext::getResult () const
 {
 	return result;
 }
 
+bool TaskContext::isSuspended () const
+{
+	ScopedLock lock (runtimeLock);
+	return suspended;
+}
+
 bool TaskContext::wasAborted () const
 {
-	return getState() == taskAborted;
+	const TaskState state = getState ();
+	return state == taskAborted || state == taskTimedOut;
 }
 
 TaskContext::TaskState TaskContext::getState () const
@@ -73,183 +292,1351 @@ TaskContext::TaskState TaskContext::getState () const
 	return currentState;
 }
 
-bool TaskContext::hasFinished () const
-{
-	// Probably no real need to lock this...
-	return (currentState == taskCompleted) || (currentState == taskAborted);
-}
+bool TaskContext::hasFinished () const
+{
+	// Probably no real need to lock this...
+	return (currentState == taskCompleted) || (currentState == taskAborted) || (currentState == taskTimedOut);
+}
+
+String TaskContext::getStateDescription () const
+{
+	TaskState state = getState ();
+	switch (state)
+	{
+	case taskPending:	return "Waiting...";
+	case taskStarting:	return "Starting...";
+	case taskRunning:	return "Running...";
+	case taskStopping:	return "Stopping...";
+	case taskAborted:	return "Aborted.";
+	case taskTimedOut:	return "Timed out.";
+
+	case taskCompleted:	
+
+		if (getResult().wasOk())
+		{
+			return "Completed successfully.";
+		}
+		else
+		{
+			return "Failed: " + getResult().getErrorMessage();
+		}
+
+	default:;
+	};
+	return String::empty;
+}
+
+double TaskContext::getOverallProgress () const
+{
+	return overallProgress.get ();
+}
+
+String TaskContext::getOverallStatusMessage () const
+{
+	// The scopes' messages, and the links between the scopes, are only ever
+	// changed with this lock held, so the hierarchy can't change under us.
+	const ScopedLock sl (statusMessageLock);
+
+	const int stamp = statusMessageStamp.get ();
+
+	if (stamp == overallStatusMessageStamp)
+		return overallStatusMessage;
+
+	// The message has changed since it was last asked for, so it needs to be
+	// built from the scope hierarchy.
+	const ProgressiveTask::ExecutionScope* rootScope = activeTask->getScope ();
+	if (rootScope == nullptr)
+		return overallStatusMessage;
+
+	overallStatusMessage = rootScope->getStatusMessage ();
+	overallStatusMessageStamp = stamp;
+	return overallStatusMessage;
+}
+
+int TaskContext::getUpdateCount () const
+{
+	return updateCount.get ();
+}
+
+void TaskContext::publishProgress (double progress)
+{
+	overallProgress.set (progress);
+	++updateCount;
+}
+
+void TaskContext::statusMessageChanged ()
+{
+	++updateCount;
+	notifyStatusMessageChanged ();
+}
+
+bool TaskContext::currentTaskShouldExit ()
+{
+	if (taskThread != nullptr)
+	{
+		return taskThread->currentTaskShouldExit();
+	}
+	return true;
+}
+
+juce::Result TaskContext::runTask (TaskThreadBase& threadBase)
+{
+	if (threadBase.canSuspendTasks ())
+	{
+		ResumableTask* resumable = dynamic_cast< ResumableTask* > (activeTask.get());
+
+		if (resumable != nullptr)
+			return runStep (threadBase, *resumable);
+	}
+
+	ScopedRunTime runTime (*this, threadBase);
+
+	ProgressiveTask::ExecutionScope localRunTime (*this, *activeTask, nullptr);
+
+	setState (taskRunning);
+
+	Result cachedResult (Result::ok ());
+	var payload;
+
+	if (lookUpCachedResult (cachedResult, payload))
+	{
+		applyCachedResult (cachedResult, payload);
+	}
+	else if (! startDeadline ())
+	{
+		// The deadline had already passed, so there's no point starting.
+		result = activeTask->getAbortResult ();
+	}
+	else
+	{
+		restoreCheckpoint (localRunTime);
+		result = activeTask->run ();
+		storeResultInCache ();
+		discardCheckpoint ();
+	}
+
+	// Make sure the final status message is cached before the scope goes.
+	getOverallStatusMessage ();
+
+	setState (taskStopping);
+
+	return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void TaskContext::setResultCache (TaskResultCache* cache)
+{
+	resultCache = cache;
+}
+
+TaskResultCache* TaskContext::getResultCache () const
+{
+	return resultCache;
+}
+
+bool TaskContext::wasResultCached () const
+{
+	return resultWasCached;
+}
+
+bool TaskContext::runFromCache ()
+{
+	Result cachedResult (Result::ok ());
+	var payload;
+
+	if (getState () != taskPending || ! lookUpCachedResult (cachedResult, payload))
+		return false;
+
+	// The cached result is applied on the thread which added the task.
+	InlineTaskRunner runner;
+	ScopedRunTime runTime (*this, runner);
+
+	ProgressiveTask::ExecutionScope localRunTime (*this, *activeTask, nullptr);
+
+	setState (taskRunning);
+	applyCachedResult (cachedResult, payload);
+	getOverallStatusMessage ();
+	setState (taskStopping);
+
+	return true;
+}
+
+bool TaskContext::lookUpCachedResult (Result& cachedResult, var& payload)
+{
+	// The cache is only asked once, so that a context which a pool has
+	// already checked doesn't count as a second miss when it runs.
+	if (resultCache == nullptr || resultCacheChecked)
+		return false;
+
+	resultCacheChecked = true;
+
+	const String key (activeTask->getCacheKey ());
+	return key.isNotEmpty () && resultCache->lookup (key, cachedResult, payload);
+}
+
+void TaskContext::applyCachedResult (const Result& cachedResult, const var& payload)
+{
+	activeTask->restoreFromCachePayload (payload);
+	activeTask->setProgress (1.0);
+
+	result = cachedResult;
+	resultWasCached = true;
+}
+
+void TaskContext::storeResultInCache ()
+{
+	// An aborted task's result is probably incomplete.
+	if (resultCache == nullptr || result.failed () || activeTask->cancellationToken.isCancelled ()
+		|| currentTaskShouldExit ())
+		return;
+
+	const String key (activeTask->getCacheKey ());
+	if (key.isNotEmpty ())
+		resultCache->store (key, result, activeTask->getCachePayload ());
+}
+
+void TaskContext::setCheckpointToResume (const var& checkpoint)
+{
+	jassert (getState () == taskPending);
+	checkpointToResume = checkpoint;
+}
+
+void TaskContext::setCheckpointFile (const File& file)
+{
+	jassert (getState () == taskPending);
+	checkpointFile = file;
+}
+
+var TaskContext::getLastCheckpoint () const
+{
+	ScopedLock lock (runtimeLock);
+	return lastCheckpoint;
+}
+
+bool TaskContext::saveCheckpoint ()
+{
+	var checkpoint;
+	{
+		ScopedLock lock (runtimeLock);
+
+		const ProgressiveTask::ExecutionScope* rootScope = activeTask->getScope ();
+		if (rootScope == nullptr)
+			return false;
+
+		checkpoint = rootScope->createCheckpoint ();
+		lastCheckpoint = checkpoint;
+	}
+
+	// The file is replaced in one go, so a crash part way through saving
+	// still leaves the previous checkpoint intact.
+	if (checkpointFile != File::nonexistent)
+		checkpointFile.replaceWithText (JSON::toString (checkpoint));
+
+	callListeners (&Listener::taskCheckpointSaved);
+	return true;
+}
+
+void TaskContext::restoreCheckpoint (ProgressiveTask::ExecutionScope& rootScope)
+{
+	if (checkpointToResume.isVoid () && checkpointFile.existsAsFile ())
+		checkpointToResume = JSON::parse (checkpointFile);
+
+	rootScope.checkpointToRestore = checkpointToResume;
+	checkpointToResume = var ();
+
+	rootScope.restoreCheckpoint ();
+}
+
+void TaskContext::discardCheckpoint ()
+{
+	// An aborted task keeps its checkpoint, so that it can be resumed later.
+	if (activeTask->cancellationToken.isCancelled () || currentTaskShouldExit ())
+		return;
+
+	if (checkpointFile != File::nonexistent)
+		checkpointFile.deleteFile ();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/** Aborts the context's task when its deadline passes. */
+class TaskContext::DeadlineTimeout	:	public TaskWatchdog::Timeout
+{
+public:
+
+	DeadlineTimeout (TaskContext& owner_) : owner (owner_) {}
+
+	virtual void timeoutExpired () override
+	{
+		owner.deadlineExpired ();
+	}
+
+private:
+
+	TaskContext& owner;
+};
+
+void TaskContext::setDeadline (Time newDeadline)
+{
+	jassert (getState () == taskPending);
+	deadline = newDeadline;
+}
+
+void TaskContext::setTimeout (int milliseconds)
+{
+	jassert (getState () == taskPending);
+	timeoutMs = milliseconds;
+}
+
+bool TaskContext::hasTimedOut () const
+{
+	return getState () == taskTimedOut;
+}
+
+bool TaskContext::startDeadline ()
+{
+	const bool hasDeadline = deadline.toMilliseconds () > 0;
+
+	if (timeoutMs < 0 && ! hasDeadline)
+		return true;
+
+	int64 delay = timeoutMs >= 0 ? timeoutMs : (int64) std::numeric_limits< int >::max ();
+
+	if (hasDeadline)
+		delay = jmin (delay, (deadline - Time::getCurrentTime ()).inMilliseconds ());
+
+	if (delay <= 0)
+	{
+		deadlineExpired ();
+		return false;
+	}
+
+	if (deadlineTimeout == nullptr)
+		deadlineTimeout = new DeadlineTimeout (*this);
+
+	TaskWatchdog::getInstance ().schedule (*deadlineTimeout, (int) delay);
+	return true;
+}
+
+void TaskContext::stopDeadline ()
+{
+	if (deadlineTimeout != nullptr)
+		TaskWatchdog::getInstance ().cancel (*deadlineTimeout);
+}
+
+void TaskContext::deadlineExpired ()
+{
+	// This is called from the watchdog's thread; the flag is set first, so
+	// that the abort is reported as a time out.
+	timedOut.set (1);
+	activeTask->abort ();
+
+	// A task which is suspended between steps won't notice until it's next
+	// run, so it's woken up now rather than when its sleep (or the context
+	// it's waiting for) finishes.
+	WakeUpHandler::Ptr handler;
+	{
+		ScopedLock lock (runtimeLock);
+		handler = wakeUpHandler;
+	}
+
+	if (handler != nullptr)
+		handler->wakeUp ();
+}
+
+void TaskContext::setWakeUpHandler (WakeUpHandler* handler)
+{
+	WakeUpHandler::Ptr oldHandler (handler);
+	{
+		ScopedLock lock (runtimeLock);
+		oldHandler.swapWith (wakeUpHandler);
+	}
+
+	// If the deadline passed before the handler was set, the task would
+	// otherwise never be woken.
+	if (handler != nullptr && activeTask->cancellationToken.isCancelled ())
+		handler->wakeUp ();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+juce::Result TaskContext::runStep (TaskThreadBase& threadBase, ResumableTask& task)
+{
+	jassert (threadBase.isCurrentTaskThread());
+
+	bool resuming;
+	WakeUpHandler::Ptr oldWakeUpHandler;
+	{
+		ScopedLock lock (runtimeLock);
+
+		taskThread = &threadBase;
+		resuming = suspended;
+		suspended = false;
+		oldWakeUpHandler.swapWith (wakeUpHandler);
+	}
+
+	// The handler probably holds a reference to this context, so it's let go
+	// of without the lock.
+	oldWakeUpHandler = nullptr;
+
+	if (! resuming)
+	{
+		publishProgress (0.0);
+		setState (taskStarting);
+	}
+
+	ResumableTask::Step step;
+	{
+		// Each step gets a fresh root scope, so the progress reached by the
+		// previous step has to be carried over.
+		ProgressiveTask::ExecutionScope localRunTime (*this, task, nullptr);
+
+		Result cachedResult (Result::ok ());
+		var payload;
+
+		if (resuming)
+		{
+			localRunTime.setProgress (suspendedProgress);
+			step = task.resume ();
+		}
+		else
+		{
+			setState (taskRunning);
+
+			if (lookUpCachedResult (cachedResult, payload))
+			{
+				applyCachedResult (cachedResult, payload);
+				step = ResumableTask::Step::finished (cachedResult);
+			}
+			else if (! startDeadline ())
+			{
+				step = ResumableTask::Step::finished (task.getAbortResult ());
+			}
+			else
+			{
+				restoreCheckpoint (localRunTime);
+				step = task.resume ();
+			}
+		}
+
+		// A task which has been aborted is never suspended again, even if
+		// it didn't notice.
+		if (! step.isFinished () && task.cancellationToken.isCancelled ())
+			step = ResumableTask::Step::finished (task.getAbortResult ());
+
+		suspendedProgress = localRunTime.getProgress ();
+
+		if (step.isFinished ())
+		{
+			result = step.getResult ();
+
+			if (! resultWasCached)
+			{
+				storeResultInCache ();
+				discardCheckpoint ();
+			}
+
+			getOverallStatusMessage ();
+			setState (taskStopping);
+		}
+	}
+
+	if (step.isFinished ())
+		setState (taskCompleted);
+
+	ScopedLock lock (runtimeLock);
+
+	if (! step.isFinished ())
+	{
+		task.pendingStep = step;
+		suspended = true;
+	}
+
+	taskThread = nullptr;
+	return result;
+}
+
+void TaskContext::abortSuspendedTask ()
+{
+	WakeUpHandler::Ptr oldWakeUpHandler;
+	{
+		ScopedLock lock (runtimeLock);
+
+		// It may have been picked up and resumed in the meantime.
+		if (! suspended)
+			return;
+
+		suspended = false;
+		oldWakeUpHandler.swapWith (wakeUpHandler);
+	}
+
+	oldWakeUpHandler = nullptr;
+
+	activeTask->abort ();
+	result = activeTask->getAbortResult ();
+
+	setState (taskStopping);
+	setState (taskAborted);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+class TaskContext::FinishedCallbacksWork	:	public TaskDispatcher::Work
+{
+public:
+
+	FinishedCallbacksWork (TaskContext* context_) : context (context_) {}
+
+	virtual void run () override
+	{
+		context->flush ();
+	}
+
+private:
+
+	TaskContext::Ptr context;
+};
+
+void TaskContext::flush ()
+{
+	if (finishedCallbacksPending.compareAndSetBool (0, 1))
+		dispatchFinishedCallbacks ();
+}
+
+void TaskContext::dispatchFinishedCallbacks ()
+{
+	bool aborted = wasAborted();
+
+	callListeners (&TaskContext::Listener::aboutToDispatchTaskFinishedCallbacks);
+
+	for (int i=0; i<callbacks.size(); i++)
+	{
+		ProgressiveTask::Callback* callback = callbacks.getUnchecked (i);
+		callback->taskFinishedCallback (result, aborted);
+	}
+	callbacks.clear ();
+
+	callListeners (&TaskContext::Listener::taskFinishedCallbacksDispatched);
+}
+
+void TaskContext::setState (TaskState state)
+{
+	bool changed = false;
+	bool stopping = false;
+	bool finished = false;
+
+	{
+		ScopedLock lock (runtimeLock);
+
+		if (state != currentState)
+		{
+			currentState = state;
+			changed = true;
+
+			switch (currentState)
+			{
+			case taskStopping:
+
+				stopping = true;
+				break;
+
+			case taskStarting:
+
+				taskAboutToStart ();
+				break;
+
+			case taskCompleted:
+			case taskAborted:
+			case taskTimedOut:
+
+				if (currentTaskShouldExit() || activeTask->cancellationToken.isCancelled ())
+				{
+					currentState = (timedOut.get () != 0) ? taskTimedOut : taskAborted;
+				}
+
+				finishedCallbacksPending.set (1);
+				finished = true;
+
+				taskAboutToTerminate ();
+				break;
+
+			default:
+
+				break;
+			};
+
+			TaskTracer::contextStateChanged (*this);
+		}
+	}
+
+	// The listeners are called without the lock, so that a slow listener
+	// (or one which locks the context) can't hold up the task.
+	if (stopping)
+	{
+		// The task has finished, so it can't overrun its deadline now.
+		stopDeadline ();
+
+		// Make sure that any throttled listeners see the final values.
+		flushPendingNotifications ();
+	}
+
+	if (changed)
+		callListeners (&TaskContext::Listener::taskStateChanged);
+
+	// This is done without the lock, as the continuations may add tasks to
+	// a pool, and the dispatcher may run the callbacks straight away.
+	if (finished)
+	{
+		runContinuations ();
+		dispatcher->dispatch (new FinishedCallbacksWork (this));
+	}
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/** Either a user Continuation, or a context prepared by then() which just
+	needs adding to the pool. */
+class TaskContext::PendingContinuation
+{
+public:
+
+	PendingContinuation (Continuation* continuation_, TaskThreadPool& pool_)
+		:	continuation (continuation_),
+			pool (pool_),
+			onlyIfSucceeded (false)
+	{
+	}
+
+	PendingContinuation (TaskContext* nextContext_, TaskThreadPool& pool_, bool onlyIfSucceeded_)
+		:	nextContext (nextContext_),
+			pool (pool_),
+			onlyIfSucceeded (onlyIfSucceeded_)
+	{
+	}
+
+	ScopedPointer< Continuation > continuation;
+	TaskContext::Ptr nextContext;
+	TaskThreadPool& pool;
+	const bool onlyIfSucceeded;
+};
+
+TaskContext& TaskContext::then (ProgressiveTask* nextTask, TaskThreadPool& pool, bool onlyIfSucceeded)
+{
+	TaskContext* nextContext = pool.createContextForTask (nextTask);
+
+	if (nextContext == nullptr)
+		nextContext = new TaskContext (nextTask);
+
+	// The pending entry keeps the new context alive until it's been run.
+	addContinuation (new PendingContinuation (nextContext, pool, onlyIfSucceeded));
+	return *nextContext;
+}
+
+void TaskContext::then (Continuation* continuation, TaskThreadPool& pool)
+{
+	jassert (continuation != nullptr);
+	addContinuation (new PendingContinuation (continuation, pool));
+}
+
+void TaskContext::addContinuation (PendingContinuation* continuation)
+{
+	ScopedPointer< PendingContinuation > pending (continuation);
+
+	{
+		ScopedLock lock (runtimeLock);
+
+		if (! hasFinished ())
+		{
+			continuations.add (pending.release ());
+			return;
+		}
+	}
+
+	runContinuation (*pending);
+}
+
+Result TaskContext::getPredecessorResult () const
+{
+	return predecessorResult;
+}
+
+void TaskContext::runContinuations ()
+{
+	OwnedArray< PendingContinuation > continuationsToRun;
+
+	{
+		ScopedLock lock (runtimeLock);
+		continuationsToRun.swapWith (continuations);
+	}
+
+	for (int i = 0; i < continuationsToRun.size(); ++i)
+		runContinuation (*continuationsToRun.getUnchecked (i));
+}
+
+void TaskContext::runContinuation (PendingContinuation& pending)
+{
+	if (pending.nextContext != nullptr)
+	{
+		pending.nextContext->predecessorResult = result;
+
+		if (pending.onlyIfSucceeded && (wasAborted () || result.failed ()))
+		{
+			// The skipped context still has to finish, so that its callbacks
+			// (and anything waiting on it, including its own continuations)
+			// aren't left hanging.
+			pending.nextContext->getTask().abort ();
+			pending.nextContext->setState (taskAborted);
+			return;
+		}
+
+		pending.pool.addTask (pending.nextContext.getObject ());
+	}
+	else
+	{
+		ProgressiveTask* task = pending.continuation->createNextTask (*this);
+
+		if (task != nullptr)
+		{
+			// The result has to be set before the context is added, as it
+			// could be run (or even finished and deleted) straight away.
+			TaskContext::Ptr nextContext (pending.pool.createContextForTask (task));
+
+			if (nextContext == nullptr)
+				nextContext = new TaskContext (task);
+
+			nextContext->predecessorResult = result;
+			pending.pool.addTask (nextContext.getObject ());
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void TaskContext::taskAboutToStart ()
+{
+
+}
+
+void TaskContext::taskAboutToTerminate ()
+{
+
+}
+
+void TaskContext::addListener (Listener* listener)
+{
+	addListener (listener, NotificationPolicy ());
+}
+
+void TaskContext::addListener (Listener* listener, const NotificationPolicy& policy)
+{
+	jassert (listener != nullptr);
+
+	ScopedLock lock (listenerWriteLock);
+
+	const ListenerSnapshot::Ptr current (getListeners ());
+	ListenerSnapshot::Ptr updated (new ListenerSnapshot ());
+
+	if (current != nullptr)
+	{
+		for (int i = 0; i < current->entries.size(); ++i)
+		{
+			if (current->entries.getObjectPointerUnchecked (i)->listener == listener)
+				return;
+		}
+
+		updated->entries.addArray (current->entries);
+	}
+
+	updated->entries.add (new ListenerEntry (listener, policy));
+	setListeners (updated);
+}
+
+void TaskContext::removeListener (Listener* listener)
+{
+	ListenerEntry::Ptr removedEntry;
+
+	{
+		ScopedLock lock (listenerWriteLock);
+
+		const ListenerSnapshot::Ptr current (getListeners ());
+		if (current == nullptr)
+			return;
+
+		ListenerSnapshot::Ptr updated (new ListenerSnapshot ());
+
+		for (int i = 0; i < current->entries.size(); ++i)
+		{
+			ListenerEntry* entry = current->entries.getObjectPointerUnchecked (i);
+
+			if (entry->listener == listener)
+				removedEntry = entry;
+			else
+				updated->entries.add (entry);
+		}
+
+		if (removedEntry == nullptr)
+			return;
+
+		if (updated->entries.size() == 0)
+			updated = nullptr;
+
+		setListeners (updated);
+	}
+
+	// Once this returns, the listener won't be called again, even by a
+	// notification which is still using an older snapshot.
+	removedEntry->markRemoved ();
+}
+
+TaskContext::ListenerSnapshot::Ptr TaskContext::getListeners () const
+{
+	const SpinLock::ScopedLockType sl (listenersLock);
+	return listeners;
+}
+
+void TaskContext::setListeners (ListenerSnapshot* newListeners)
+{
+	ListenerSnapshot::Ptr old;
+
+	{
+		const SpinLock::ScopedLockType sl (listenersLock);
+		old = listeners;
+		listeners = newListeners;
+	}
+
+	// The old snapshot (if this was its last reference) is released here,
+	// outside the spin lock.
+}
+
+void TaskContext::callListeners (ListenerCallback callback)
+{
+	const ListenerSnapshot::Ptr snapshot (getListeners ());
+	if (snapshot == nullptr)
+		return;
+
+	for (int i = snapshot->entries.size(); --i >= 0;)
+		snapshot->entries.getObjectPointerUnchecked (i)->call (callback, *this);
+}
+
+void TaskContext::notifyProgressChanged ()
+{
+	const ListenerSnapshot::Ptr snapshot (getListeners ());
+	if (snapshot == nullptr)
+		return;
+
+	const double progress = getOverallProgress ();
+	const double now = Time::getMillisecondCounterHiRes ();
+
+	for (int i = snapshot->entries.size(); --i >= 0;)
+		snapshot->entries.getObjectPointerUnchecked (i)->notifyProgressChanged (*this, progress, now);
+}
+
+void TaskContext::notifyStatusMessageChanged ()
+{
+	const ListenerSnapshot::Ptr snapshot (getListeners ());
+	if (snapshot == nullptr)
+		return;
+
+	const double now = Time::getMillisecondCounterHiRes ();
+
+	for (int i = snapshot->entries.size(); --i >= 0;)
+		snapshot->entries.getObjectPointerUnchecked (i)->notifyStatusMessageChanged (*this, now);
+}
+
+void TaskContext::flushPendingNotifications ()
+{
+	const ListenerSnapshot::Ptr snapshot (getListeners ());
+	if (snapshot == nullptr)
+		return;
+
+	const double progress = getOverallProgress ();
+	const double now = Time::getMillisecondCounterHiRes ();
+
+	for (int i = snapshot->entries.size(); --i >= 0;)
+		snapshot->entries.getObjectPointerUnchecked (i)->flushPendingNotifications (*this, progress, now);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/**
+	Runs a set of sub-tasks concurrently, for performSubTaskSequenceParallel()
+	and performSubTaskGraph(). A sub-task becomes ready once all of the
+	sub-tasks it depends on have finished, and ready sub-tasks are claimed in
+	order by whichever threads are taking part (the owning task's thread,
+	plus any Runner jobs added to the pool). The sub-tasks' progress is
+	combined into the parent scope.
+*/
+///////////////////////////////////////////////////////////////////////////////
+
+class ProgressiveTask::SubTaskGroup	:	public ReferenceCountedObject
+{
+public:
+
+	typedef ReferenceCountedObjectPtr< SubTaskGroup > Ptr;
+
+	class Runner;
+
+	SubTaskGroup (ExecutionScope& parentScope, const TaskSequence& sequence_,
+				  const Array< Array< int > >* dependentsOfTasks,
+				  double proportionOfProgress, bool stopOnError_, TaskThreadPool& pool_)
+		:	parent (parentScope),
+			sequence (sequence_),
+			pool (pool_),
+			numTasks (sequence_.size()),
+			maxRunners (jmin (sequence_.size(), pool_.getMaxConcurrentTasks() + 1)),
+			progressAtStart (parentScope.getProgress ()),
+			progressAtEnd (jmin (progressAtStart + proportionOfProgress, 1.0)),
+			runnerName (parentScope.getTask().getName()),
+			overallProgress (0.0),
+			latestProgress (progressAtStart),
+			progressChanged (false),
+			isPublishingProgress (false),
+			numRunners (1),
+			numFinished (0),
+			failedIndex (-1),
+			stopOnError (stopOnError_)
+	{
+		for (int i = 0; i < numTasks; ++i)
+		{
+			proportions.add (sequence.getTaskProportion (i));
+			progress.add (0.0);
+			results.add (Result::ok());
+			numDependencies.add (0);
+			blocked.add (false);
+			dependents.add (Array< int > ());
+		}
+
+		if (dependentsOfTasks != nullptr)
+		{
+			jassert (dependentsOfTasks->size() == numTasks);
+
+			for (int i = 0; i < jmin (numTasks, dependentsOfTasks->size()); ++i)
+			{
+				const Array< int >& taskDependents = dependentsOfTasks->getReference (i);
+				dependents.set (i, taskDependents);
+
+				for (int j = 0; j < taskDependents.size(); ++j)
+					numDependencies.getReference (taskDependents.getUnchecked (j))++;
+			}
+		}
+
+		for (int i = 0; i < numTasks; ++i)
+		{
+			if (numDependencies.getUnchecked (i) == 0)
+				readyTasks.add (i);
+		}
+
+		token.setParent (&parentScope.getTask().cancellationToken);
+	}
+
+	/** Adds as many Runner jobs to the pool as could usefully be running. */
+	void addRunners ()
+	{
+		int numToAdd = 0;
+		{
+			ScopedLock lock (groupLock);
+			numToAdd = getNumRunnersNeeded ();
+		}
+		addRunnersToPool (numToAdd);
+	}
+
+	/** Called by the owning task's thread; this runs sub-tasks as they become
+		ready, and returns once all of them have finished. */
+	void runUntilFinished ()
+	{
+		for (;;)
+		{
+			runReadySubTasks (true);
+
+			{
+				ScopedLock lock (groupLock);
+
+				if (numFinished == numTasks)
+					return;
+			}
+
+			readyOrFinished.wait (50);
+		}
+	}
+
+	/** Called by Runner jobs; this runs sub-tasks until there are none ready.
+		Note that the sequence and parent scope may only be touched once a
+		sub-task has been claimed, as the owner is then waiting for it. */
+	void runReadySubTasks (bool isOwner)
+	{
+		for (;;)
+		{
+			int index = -1;
+			bool shouldRun = false;
+
+			{
+				ScopedLock lock (groupLock);
+
+				if (readyTasks.size() == 0)
+				{
+					if (! isOwner)
+						--numRunners;
+
+					return;
+				}
+
+				index = readyTasks.getFirst ();
+				readyTasks.remove (0);
+				shouldRun = ! (token.isCancelled () || blocked.getUnchecked (index));
+			}
+
+			subTaskFinished (index, shouldRun ? runSubTask (index) : Result::ok(), shouldRun);
+		}
+	}
+
+	CancellationToken& getCancellationToken ()
+	{
+		return token;
+	}
+
+	/** Unlinks the group's token from the parent task's, which must be done
+		before the parent's scope ends. */
+	void detach ()
+	{
+		token.setParent (nullptr);
+	}
+
+	Result getResult () const
+	{
+		if (failedIndex >= 0)
+			return results.getReference (failedIndex);
+
+		StringArray errorMessages;
+
+		for (int i = 0; i < results.size(); ++i)
+		{
+			if (results.getReference (i).failed())
+				errorMessages.add (results.getReference (i).getErrorMessage());
+		}
+
+		if (errorMessages.size () > 0)
+			return Result::fail (errorMessages.joinIntoString (newLine));
+
+		return Result::ok ();
+	}
+
+	bool hasStopped () const
+	{
+		return failedIndex >= 0;
+	}
+
+	double getProgressAtEnd () const
+	{
+		return progressAtEnd;
+	}
+
+	void subTaskProgressChanged (ExecutionScope& subTaskScope)
+	{
+		{
+			ScopedLock lock (groupLock);
+			setSubTaskProgress (subTaskScope.index, subTaskScope.progress);
+		}
+		publishProgress ();
+	}
+
+	void subTaskStatusMessageChanged ()
+	{
+		// The sub-task has already made itself the parent's source of status
+		// messages, so the parent builds its message from it when asked.
+		parent.notifyStatusMessageChanged ();
+	}
+
+private:
 
-String TaskContext::getStateDescription () const
-{
-	TaskState state = getState ();
-	switch (state)
+	Result runSubTask (int index)
 	{
-	case taskPending:	return "Waiting...";
-	case taskStarting:	return "Starting...";
-	case taskRunning:	return "Running...";
-	case taskStopping:	return "Stopping...";
-	case taskAborted:	return "Aborted.";
+		ProgressiveTask& subTask = *sequence.getTask (index);
 
-	case taskCompleted:	
+		if (subTask.isRunning())
+			return taskAlreadyRunning;
 
-		if (getResult().wasOk())
+		// The scope links the sub-task's token beneath ours, so stopping the
+		// group (or aborting the parent) reaches it straight away.
+		ExecutionScope subTaskScope (parent.getContext(), subTask, &parent, 1.0, index, numTasks, this);
+
+		return subTask.run ();
+	}
+
+	void subTaskFinished (int index, const Result& result, bool wasRun)
+	{
+		int numRunnersToAdd = 0;
+
+		// The progress is published before the task is counted as finished,
+		// as the owner may leave the parent's scope as soon as it is.
 		{
-			return "Completed successfully.";
+			ScopedLock lock (groupLock);
+			setSubTaskProgress (index, 1.0);
 		}
-		else
+		publishProgress ();
+
 		{
-			return "Failed: " + getResult().getErrorMessage();
-		}
+			ScopedLock lock (groupLock);
 
-	default:;
-	};
-	return String::empty;
-}
+			// Anything depending on a task that failed (or didn't run) is
+			// skipped, rather than being run with missing inputs.
+			const bool blockDependents = result.failed() || ! wasRun;
 
-bool TaskContext::currentTaskShouldExit ()
-{
-	if (taskThread != nullptr)
-	{
-		return taskThread->currentTaskShouldExit();
-	}
-	return true;
-}
+			if (result.failed())
+			{
+				results.set (index, result);
 
-juce::Result TaskContext::runTask (TaskThreadBase& threadBase)
-{
-	ScopedRunTime runTime (*this, threadBase);
+				if (stopOnError && failedIndex < 0)
+				{
+					failedIndex = index;
+					token.cancel ();
+				}
+			}
 
-	ProgressiveTask::ExecutionScope localRunTime (*this, *activeTask, nullptr);
+			const Array< int >& taskDependents = dependents.getReference (index);
 
-	setState (taskRunning);
-	result = activeTask->run ();
-	setState (taskStopping);
+			for (int i = 0; i < taskDependents.size(); ++i)
+			{
+				const int dependent = taskDependents.getUnchecked (i);
 
-	return result;
-}
+				if (blockDependents)
+					blocked.set (dependent, true);
 
-void TaskContext::handleAsyncUpdate ()
-{
-	bool aborted = wasAborted();
+				if (--(numDependencies.getReference (dependent)) == 0)
+					readyTasks.add (dependent);
+			}
 
-	listeners.call (&TaskContext::Listener::aboutToDispatchTaskFinishedCallbacks, *this);
+			++numFinished;
 
-	for (int i=0; i<callbacks.size(); i++)
-	{
-		ProgressiveTask::Callback* callback = callbacks.getUnchecked (i);
-		callback->taskFinishedCallback (result, aborted);
-	}
-	callbacks.clear ();
+			numRunnersToAdd = getNumRunnersNeeded ();
+		}
 
-	listeners.call (&TaskContext::Listener::taskFinishedCallbacksDispatched, *this);
-}
+		readyOrFinished.signal ();
+		addRunnersToPool (numRunnersToAdd);
+	}
 
-void TaskContext::setState (TaskState state)
-{
-	ScopedLock lock (runtimeLock);
+	int getNumRunnersNeeded ()
+	{
+		// The owning thread is always counted as a runner, but it might be
+		// busy, so there should be a helper for each ready task (up to the
+		// limit the pool can actually run).
+		const int numNeeded = jmin (readyTasks.size(), maxRunners - 1) - (numRunners - 1);
+		if (numNeeded <= 0 || token.isCancelled ())
+			return 0;
+
+		numRunners += numNeeded;
+		return numNeeded;
+	}
 
-	if (state != currentState)
+	void addRunnersToPool (int numToAdd)
 	{
-		currentState = state;
+		// This is called without the lock, once the owner may have finished
+		// with the group and left the parent's scope, so it mustn't touch the
+		// parent at all.
+		for (int i = 0; i < numToAdd; ++i)
+			pool.addTask (new Runner (runnerName, this));
+	}
 
-		switch (currentState)
-		{
-		case taskStarting:
+	void setSubTaskProgress (int index, double newProgress)
+	{
+		overallProgress += proportions.getUnchecked (index) * (newProgress - progress.getUnchecked (index));
+		progress.set (index, newProgress);
 
-			taskAboutToStart ();
-			break;
+		const double amount = jlimit (0.0, 1.0, overallProgress);
+		latestProgress = progressAtStart + amount * (progressAtEnd - progressAtStart);
+		progressChanged = true;
+	}
 
-		case taskCompleted:
-		case taskAborted:
+	void publishProgress ()
+	{
+		// The parent's listeners are called without the lock held. Only one
+		// thread publishes at a time, and it carries on until it has sent the
+		// latest value, so the others don't need to wait for it. This is only
+		// called from an unfinished sub-task, so the parent is still there.
+		for (;;)
+		{
+			double newProgress = 0.0;
 
-			if (currentTaskShouldExit() || activeTask->abortSignal)
 			{
-				currentState = taskAborted;
-			}
-
-			triggerAsyncUpdate ();
+				ScopedLock lock (groupLock);
 
-			taskAboutToTerminate ();
-			break;
+				if (isPublishingProgress || ! progressChanged)
+					return;
 
-		default:
+				isPublishingProgress = true;
+				progressChanged = false;
+				newProgress = latestProgress;
+			}
 
-			break;
-		};
+			parent.setProgress (newProgress);
 
-		listeners.call (&TaskContext::Listener::taskStateChanged, *this);
+			ScopedLock lock (groupLock);
+			isPublishingProgress = false;
+		}
 	}
-}
-
 
-void TaskContext::taskAboutToStart ()
-{
+	ExecutionScope& parent;
+	const TaskSequence& sequence;
+	TaskThreadPool& pool;
+	const int numTasks;
+	const int maxRunners;
+	const double progressAtStart;
+	const double progressAtEnd;
+	const String runnerName;
+
+	CriticalSection groupLock;
+	Array< double > proportions;
+	Array< double > progress;
+	Array< Result > results;
+	Array< int > numDependencies;
+	Array< bool > blocked;
+	Array< Array< int > > dependents;
+	Array< int > readyTasks;
+	double overallProgress;
+	double latestProgress;
+	bool progressChanged;
+	bool isPublishingProgress;
+	int numRunners;
+	int numFinished;
+	int failedIndex;
+	const bool stopOnError;
+
+	CancellationToken token;	// cancelled when the group stops
+	WaitableEvent readyOrFinished;
+
+	JUCE_DECLARE_NON_COPYABLE (SubTaskGroup);
+};
 
-}
+///////////////////////////////////////////////////////////////////////////////
 
-void TaskContext::taskAboutToTerminate ()
+class ProgressiveTask::SubTaskGroup::Runner	:	public ProgressiveTask
 {
+public:
 
-}
+	Runner (const String& taskName, SubTaskGroup* groupToRun)
+		:	ProgressiveTask (taskName),
+			group (groupToRun)
+	{
+	}
 
-void TaskContext::addListener (Listener* listener)
-{
-	listeners.add (listener);
-}
+	virtual Result run () override
+	{
+		group->runReadySubTasks (false);
+		return Result::ok ();
+	}
 
-void TaskContext::removeListener (Listener* listener)
-{
-	listeners.remove (listener);
-}
+private:
 
-void TaskContext::flush ()
-{
-	handleUpdateNowIfNeeded ();
-}
+	SubTaskGroup::Ptr group;
+};
 
 ///////////////////////////////////////////////////////////////////////////////
 
 ProgressiveTask::ExecutionScope::ExecutionScope (TaskContext& executionContext, ProgressiveTask& task_, 
 												 ExecutionScope* parentScope_,
 												double proportionOfProgress, 
-												int index_, int count_)
+												int index_, int count_,
+												SubTaskGroup* group_, int call_)
 :   context (executionContext),
 	task (task_),
 	parentScope (parentScope_),
 	subTaskScope (nullptr),
+	group (group_),
+	groupStatusScope (nullptr),
+	statusMessageStamp (0),
 	progress (0.0),
 	progressAtStart (0.0),
 	progressAtEnd (1.0),
+	progressRoot (this),
+	rootScale (1.0),
+	rootOffset (0.0),
 	index (index_),
-	count (count_)
+	count (count_),
+	call (call_),
+	numSubTaskCalls (0),
+	subTaskToResume (-1),
+	subTaskCallToResume (-1)
 {
 	ScopedLock lock (context.getLock());
+	const ScopedLock messageLock (context.statusMessageLock);
 
 	jassert (task.scope == nullptr);
 
 	task.scope = this;
 
-	if (parentScope != nullptr)
+	if (parentScope != nullptr && group == nullptr)
 	{
-		parentScope->subTaskScope = this;
-		progressAtStart = parentScope->progress;
+		progressAtStart = parentScope->getProgress ();
 		progressAtEnd = jmin (progressAtStart + proportionOfProgress, 1.0);
+		parentScope->subTaskScope = this;
+
+		progressRoot = parentScope->progressRoot;
+		rootScale = parentScope->rootScale * (progressAtEnd - progressAtStart);
+		rootOffset = parentScope->rootOffset + parentScope->rootScale * progressAtStart;
+
+		if (parentScope->subTaskToResume == index && parentScope->subTaskCallToResume == call)
+		{
+			checkpointToRestore = parentScope->subTaskCheckpoint;
+			parentScope->subTaskCheckpoint = var ();
+			parentScope->subTaskToResume = -1;
+			parentScope->subTaskCallToResume = -1;
+		}
 	}
+
+	if (group != nullptr)
+		task.cancellationToken.setParent (&group->getCancellationToken ());
+	else if (parentScope != nullptr)
+		task.cancellationToken.setParent (&parentScope->task.cancellationToken);
+
+	TaskTracer::taskBegan (task);
 }
 
 ProgressiveTask::ExecutionScope::~ExecutionScope ()
 {
+	TaskTracer::taskEnded (task);
+
     ScopedLock lock (context.getLock());
+	const ScopedLock messageLock (context.statusMessageLock);
 
 	jassert (subTaskScope == nullptr);
-    
-	task.scope = nullptr;
 
-	if (parentScope != nullptr)
+	jassert (groupStatusScope == nullptr);
+
+	if (parentScope != nullptr && group != nullptr)
+	{
+		if (parentScope->groupStatusScope == this)
+		{
+			if (statusMessageStamp > parentScope->statusMessageStamp)
+			{
+				parentScope->statusMessage = parentScope->task.formatStatusMessageFromSubTask (task);
+				parentScope->statusMessageStamp = statusMessageStamp;
+			}
+
+			parentScope->groupStatusScope = nullptr;
+		}
+	}
+	else if (parentScope != nullptr)
 	{
+		// If our message is the most recent one, it's kept as the parent's
+		// own message now that it can no longer be built on demand.
+		if (statusMessageStamp > parentScope->statusMessageStamp)
+		{
+			parentScope->statusMessage = parentScope->task.formatStatusMessageFromSubTask (task);
+			parentScope->statusMessageStamp = statusMessageStamp;
+		}
+
 		jassert (parentScope->subTaskScope == this);
+
+		// The parent's own value wasn't updated while we were running, so it
+		// has to be worked out from the progress root while it still knows
+		// that we're there.
+		parentScope->progress = parentScope->getProgress ();
 		parentScope->subTaskScope = nullptr;
 	}
+
+	task.cancellationToken.setParent (nullptr);
+	task.scope = nullptr;
 }
 
 ProgressiveTask& ProgressiveTask::ExecutionScope::getTask ()
@@ -265,29 +1652,95 @@ TaskContext& ProgressiveTask::ExecutionScope::getContext ()
 void ProgressiveTask::ExecutionScope::setProgress (double newProgress)
 {
     progress = jlimit (0.0, 1.0, newProgress);
+
+    // Rather than updating each parent in turn, the new value is mapped
+    // straight onto the progress root; the parents work out their own
+    // progress from that if they need it.
+    ExecutionScope& root = *progressRoot;
+
+    if (&root != this)
+    {
+        root.progress = jlimit (0.0, 1.0, rootOffset + rootScale * progress);
+    }
     
-    if (parentScope != nullptr)
+    if (root.group != nullptr)
     {
-        parentScope->setProgress (interpolateProgress (progress));
+        root.group->subTaskProgressChanged (root);
     }
     else
     {
-        context.listeners.call (&TaskContext::Listener::taskProgressChanged, context);
+        context.publishProgress (root.progress);
+        context.notifyProgressChanged ();
+    }
+}
+
+double ProgressiveTask::ExecutionScope::getProgress () const
+{
+    if (subTaskScope == nullptr || progressRoot == this || rootScale <= 0.0)
+    {
+        return progress;
     }
+    return jlimit (0.0, 1.0, (progressRoot->progress - rootOffset) / rootScale);
 }
 
 void ProgressiveTask::ExecutionScope::setStatusMessage (const String& message)
 {
-    statusMessage = message;
-    
-    if (parentScope != nullptr)
+    // Only the raw message is stored here; the parent scopes build their own
+    // messages from it when somebody actually asks for them.
     {
-        parentScope->setStatusMessage (parentScope->getTask().formatStatusMessageFromSubTask (task));
+        const ScopedLock sl (context.statusMessageLock);
+        statusMessage = message;
+        statusMessageStamp = ++(context.statusMessageStamp);
+    }
+
+    notifyStatusMessageChanged ();
+}
+
+void ProgressiveTask::ExecutionScope::notifyStatusMessageChanged ()
+{
+    if (group != nullptr)
+    {
+        // A parallel group's parent has no single sub-task scope, so it
+        // builds its message from whichever sub-task reported last.
+        {
+            const ScopedLock sl (context.statusMessageLock);
+            parentScope->groupStatusScope = this;
+        }
+
+        group->subTaskStatusMessageChanged ();
     }
     else
     {
-        context.listeners.call (&TaskContext::Listener::taskStatusMessageChanged, context);
+        context.statusMessageChanged ();
+    }
+}
+
+String ProgressiveTask::ExecutionScope::getStatusMessage () const
+{
+    // The lock is re-entrant, so formatStatusMessageFromSubTask() can ask a
+    // sub-task for its message.
+    const ScopedLock sl (context.statusMessageLock);
+
+    const ExecutionScope* source = subTaskScope != nullptr ? subTaskScope : groupStatusScope;
+
+    if (source != nullptr && source->getLatestStatusMessageStamp () > statusMessageStamp)
+    {
+        return task.formatStatusMessageFromSubTask (source->task);
     }
+    return statusMessage;
+}
+
+int ProgressiveTask::ExecutionScope::getLatestStatusMessageStamp () const
+{
+    int latest = statusMessageStamp;
+
+    for (const ExecutionScope* scope = subTaskScope != nullptr ? subTaskScope : groupStatusScope;
+         scope != nullptr;
+         scope = scope->subTaskScope != nullptr ? scope->subTaskScope : scope->groupStatusScope)
+    {
+        latest = jmax (latest, scope->statusMessageStamp);
+    }
+    return latest;
 }
 
 double ProgressiveTask::ExecutionScope::interpolateProgress (double amount) const
@@ -296,6 +1749,65 @@ double ProgressiveTask::ExecutionScope::interpolateProgress (double amount) cons
 	return jlimit (0.0, 1.0, progress);
 }
 
+var ProgressiveTask::ExecutionScope::createCheckpoint () const
+{
+	DynamicObject::Ptr checkpoint (new DynamicObject ());
+	checkpoint->setProperty ("task", task.getName ());
+	checkpoint->setProperty ("index", index);
+	checkpoint->setProperty ("count", count);
+	checkpoint->setProperty ("call", call);
+	checkpoint->setProperty ("progress", getProgress ());
+	checkpoint->setProperty ("state", task.getCheckpointState ());
+
+	if (subTaskScope != nullptr)
+		checkpoint->setProperty ("subTask", subTaskScope->createCheckpoint ());
+
+	return var (checkpoint);
+}
+
+void ProgressiveTask::ExecutionScope::restoreCheckpoint ()
+{
+	const var checkpoint (checkpointToRestore);
+	checkpointToRestore = var ();
+
+	// A checkpoint saved by some other task (or from a sequence which has
+	// since changed) is ignored, and the task starts from scratch.
+	if (! checkpoint.isObject () || checkpoint ["task"].toString () != task.getName ()
+		|| (int) checkpoint ["count"] != count)
+		return;
+
+	task.restoreCheckpointState (checkpoint ["state"]);
+
+	const var subTask (checkpoint ["subTask"]);
+
+	if (subTask.isObject ())
+	{
+		// The progress of a task with a sub-task is rebuilt as its completed
+		// sub-tasks are skipped, and the sub-task restores its own.
+		subTaskCheckpoint = subTask;
+		subTaskToResume = subTask ["index"];
+		subTaskCallToResume = subTask ["call"];
+	}
+	else
+	{
+		setProgress (checkpoint ["progress"]);
+	}
+}
+
+int ProgressiveTask::ExecutionScope::getSubTaskToResume (int call_, int numSubTasks) const
+{
+	if (subTaskCallToResume == call_ && subTaskToResume > 0 && subTaskToResume < numSubTasks
+		&& (int) subTaskCheckpoint ["count"] == numSubTasks)
+		return subTaskToResume;
+
+	return 0;
+}
+
+int ProgressiveTask::ExecutionScope::beginSubTaskCall ()
+{
+	return numSubTaskCalls++;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 const juce::Result ProgressiveTask::taskAlreadyRunning (Result::fail("Task already running"));
@@ -303,7 +1815,7 @@ const juce::Result ProgressiveTask::taskAlreadyRunning (Result::fail("Task alrea
 ProgressiveTask::ProgressiveTask (const String& taskName)
 	:	name (taskName),
         scope (nullptr),
-		abortSignal (false)
+		lastThreadCheckTime (0)
 {
 
 }
@@ -339,7 +1851,7 @@ void ProgressiveTask::advanceProgress (double amount)
 double ProgressiveTask::getProgress () const
 {
     if (scope != nullptr)
-        return scope->progress;
+        return scope->getProgress ();
     return 0.0;
 }
 
@@ -347,7 +1859,7 @@ double ProgressiveTask::getDistanceToTargetProgress (double target) const
 {
     if (scope != nullptr)
     {
-        return jmax (0.0, target - scope->progress);
+        return jmax (0.0, target - scope->getProgress ());
     }
     return 0.0;
 }
@@ -364,35 +1876,64 @@ String ProgressiveTask::getStatusMessage () const
 {
     if (scope != nullptr)
     {
-        return scope->statusMessage;
+        return scope->getStatusMessage ();
     }
     return String::empty;
 }
 
 void ProgressiveTask::abort ()
 {
-	abortSignal = true;
-	if (scope != nullptr)
-    {
-        if (scope->subTaskScope != nullptr)
-        {
-            scope->subTaskScope->task.abort ();
-        }
-    }
+	// Any sub-tasks (including those running in parallel) have their tokens
+	// linked beneath ours, so this reaches all of them.
+	cancellationToken.cancel ();
 }
 
 bool ProgressiveTask::shouldAbort () const
 {
-	return abortSignal || threadShouldExit ();
+	if (cancellationToken.isCancelled () || scope == nullptr)
+		return true;
+
+	// Asking the thread is comparatively expensive, so it's only done every
+	// few milliseconds. If it does want to exit, cancelling the root task's
+	// token passes that on to the whole hierarchy.
+	const uint32 now = Time::getMillisecondCounter ();
+
+	if (now - lastThreadCheckTime >= 5)
+	{
+		lastThreadCheckTime = now;
+
+		if (threadShouldExit ())
+		{
+			if (scope != nullptr)
+				scope->getContext().getTask().abort ();
+			return true;
+		}
+	}
+	return false;
+}
+
+const CancellationToken& ProgressiveTask::getCancellationToken () const
+{
+	return cancellationToken;
 }
 
 Result ProgressiveTask::performSubTask (ProgressiveTask& taskToPerform, double proportionOfProgress, int index, int count)
 {
     jassert (scope != nullptr);
-    
+
+	if (scope == nullptr)
+		return taskAlreadyRunning;
+
+	return performSubTaskInCall (taskToPerform, proportionOfProgress, index, count, scope->beginSubTaskCall ());
+}
+
+Result ProgressiveTask::performSubTaskInCall (ProgressiveTask& taskToPerform, double proportionOfProgress,
+											  int index, int count, int call)
+{
     if (scope != nullptr && !taskToPerform.isRunning())
     {
-		ExecutionScope subTask (scope->getContext(), taskToPerform, scope, proportionOfProgress, index, count);
+		ExecutionScope subTask (scope->getContext(), taskToPerform, scope, proportionOfProgress, index, count, nullptr, call);
+		subTask.restoreCheckpoint ();
         return taskToPerform.run ();
     }
     return taskAlreadyRunning;
@@ -410,7 +1951,16 @@ Result ProgressiveTask::performSubTaskSequence (const TaskSequence& sequence,
 
 	double endProgress = getProgress() + proportionOfProgress;
 
-	for (int i=0; i<sequence.size(); i++)
+	// The whole sequence is one sub-task call. When resuming from a checkpoint
+	// taken during this call, the sub-tasks which had already completed are
+	// skipped.
+	const int call = scope != nullptr ? scope->beginSubTaskCall () : 0;
+	const int firstSubTask = scope != nullptr ? scope->getSubTaskToResume (call, sequence.size()) : 0;
+
+	for (int i=0; i<firstSubTask; i++)
+		advanceProgress (sequence.getTaskProportion (i) * proportionOfProgress);
+
+	for (int i=firstSubTask; i<sequence.size(); i++)
 	{
 		if (shouldAbort())
 			return Result::ok();
@@ -419,7 +1969,8 @@ Result ProgressiveTask::performSubTaskSequence (const TaskSequence& sequence,
 
 		//notifyStatusChanged ();
 
-		Result subTaskResult = performSubTask (*subTask, sequence.getTaskProportion (i) * proportionOfProgress, i, sequence.size());
+		Result subTaskResult = performSubTaskInCall (*subTask, sequence.getTaskProportion (i) * proportionOfProgress,
+													 i, sequence.size(), call);
 
 		if (subTaskResult.failed())
 		{
@@ -443,6 +1994,51 @@ Result ProgressiveTask::performSubTaskSequence (const TaskSequence& sequence,
 
 }
 
+Result ProgressiveTask::performSubTaskSequenceParallel (const TaskSequence& sequence, double proportionOfProgress,
+                                                        bool stopOnError, TaskThreadPool& pool)
+{
+	return performSubTaskGroup (sequence, nullptr, proportionOfProgress, stopOnError, pool);
+}
+
+Result ProgressiveTask::performSubTaskGraph (const TaskSequence& tasks, const Array< Array< int > >& dependentsOfTasks,
+                                             double proportionOfProgress, bool stopOnError, TaskThreadPool& pool)
+{
+	return performSubTaskGroup (tasks, &dependentsOfTasks, proportionOfProgress, stopOnError, pool);
+}
+
+Result ProgressiveTask::performSubTaskGroup (const TaskSequence& tasks, const Array< Array< int > >* dependentsOfTasks,
+                                             double proportionOfProgress, bool stopOnError, TaskThreadPool& pool)
+{
+	jassert (scope != nullptr);
+
+	if (scope == nullptr)
+		return taskAlreadyRunning;
+
+	// A group can't be resumed, but it still takes up a call, so that the
+	// calls after it keep their ordinals.
+	scope->beginSubTaskCall ();
+
+	if (tasks.size() == 0 || shouldAbort())
+		return Result::ok();
+
+	SubTaskGroup::Ptr group (new SubTaskGroup (*scope, tasks, dependentsOfTasks, proportionOfProgress, stopOnError, pool));
+
+	group->addRunners ();
+	group->runUntilFinished ();
+	group->detach ();
+
+	if (group->hasStopped())
+	{
+		setProgress (group->getProgressAtEnd());
+	}
+	else if (shouldAbort())
+	{
+		return Result::ok();
+	}
+
+	return group->getResult ();
+}
+
 void ProgressiveTask::subTaskStarting (ProgressiveTask*, int, int)
 {
 
@@ -453,6 +2049,47 @@ String ProgressiveTask::formatStatusMessageFromSubTask (ProgressiveTask& subTask
 	return subTask.getStatusMessage ();
 }
 
+String ProgressiveTask::getCacheKey () const
+{
+	return String::empty;
+}
+
+var ProgressiveTask::getCachePayload () const
+{
+	return var ();
+}
+
+void ProgressiveTask::restoreFromCachePayload (const var&)
+{
+}
+
+var ProgressiveTask::getCheckpointState () const
+{
+	return var ();
+}
+
+void ProgressiveTask::restoreCheckpointState (const var&)
+{
+}
+
+bool ProgressiveTask::saveCheckpoint ()
+{
+	jassert (scope != nullptr);
+
+	if (scope == nullptr)
+		return false;
+
+	// Other tasks in the hierarchy carry on running while a member of a
+	// parallel group is running, so their state can't be captured.
+	for (const ExecutionScope* s = scope; s != nullptr; s = s->parentScope)
+	{
+		if (s->group != nullptr)
+			return false;
+	}
+
+	return scope->getContext().saveCheckpoint ();
+}
+
 Result ProgressiveTask::getAbortResult ()
 {
 	return Result::ok ();
@@ -485,6 +2122,25 @@ void TaskThreadBase::runTask (TaskContext::Ptr taskContext)
 	}
 }
 
+void TaskThreadBase::abortTask (TaskContext::Ptr taskContext)
+{
+	if (taskContext == nullptr)
+		return;
+
+	// A suspended task has started, but nothing is running it while it waits.
+	if (taskContext->isSuspended ())
+	{
+		taskContext->abortSuspendedTask ();
+		return;
+	}
+
+	if (taskContext->getState () != TaskContext::taskPending)
+		return;
+
+	taskContext->getTask ().abort ();
+	taskContext->setState (TaskContext::taskAborted);
+}
+
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -537,7 +2193,7 @@ void TaskInterface::setTaskContext (TaskContext* taskToView, bool alsoTriggerRef
 
 		if (taskToView != nullptr)
 		{
-			taskToView->addListener (this);
+			taskToView->addListener (this, notificationPolicy);
 		}
 
 		if (alsoTriggerRefresh)
@@ -553,6 +2209,11 @@ TaskContext* TaskInterface::getTaskContext ()
 	return task;
 }
 
+void TaskInterface::setNotificationPolicy (const TaskContext::NotificationPolicy& newPolicy)
+{
+	notificationPolicy = newPolicy;
+}
+
 void TaskInterface::refreshInternal ()
 {
 	if (task != nullptr)
@@ -4,6 +4,9 @@
 class ProgressiveTask;
 class TaskContext;
 class TaskThreadBase;
+class TaskThreadPool;
+class ResumableTask;
+class TaskResultCache;
 
 ///////////////////////////////////////////////////////////////////////////////
 /**
@@ -19,6 +22,9 @@ class TaskThreadBase;
 class ProgressiveTask
 {
 	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ProgressiveTask);
+
+	class SubTaskGroup;
+
 public:
 
     class ExecutionScope;
@@ -70,6 +76,58 @@ public:
      */
 	virtual juce::Result run () = 0;
 
+	/** A task whose result depends only on its inputs can return a key here
+		identifying those inputs, so that its result can be remembered by a
+		TaskResultCache. When a context with a cache finds an entry for this
+		key, the task isn't run at all. By default, this returns an empty
+		string, which means the task is never cached.
+	*/
+	virtual juce::String getCacheKey () const;
+
+	/** Returns any output of the task (other than its Result) which should
+		be stored in the cache along with it. If the cache has a disk tier,
+		this must be something which JSON can represent.
+	*/
+	virtual juce::var getCachePayload () const;
+
+	/** Called instead of run() when the task's result has been found in the
+		cache, with the payload returned by getCachePayload() when it was
+		stored.
+	*/
+	virtual void restoreFromCachePayload (const juce::var& payload);
+
+	/** Returns whatever this task needs to remember to carry on from where it
+		is now, for inclusion in a checkpoint (see saveCheckpoint()). This must
+		be something which JSON can represent. By default, this returns a void
+		var, and the task is simply restarted when resumed (although completed
+		sub-tasks of a TaskSequence are still skipped).
+	*/
+	virtual juce::var getCheckpointState () const;
+
+	/** Called just before the task is run to continue from a checkpoint, with
+		the value returned by getCheckpointState() when it was saved. The task's
+		progress is restored after this has been called.
+	*/
+	virtual void restoreCheckpointState (const juce::var& state);
+
+	/** Saves a checkpoint for the whole task hierarchy this task is running
+		in. This records the state of every task from the top-level one down to
+		the one currently running, along with its position in its parent's
+		sub-tasks and its progress. Long running tasks should call this now and
+		then from their run() function; the checkpoint is given to the
+		context's listeners, and written to its checkpoint file if it has one.
+
+		A task which is resumed from the checkpoint (see
+		TaskContext::setCheckpointToResume()) skips the sub-tasks of any
+		TaskSequence that had already completed, and continues from the saved
+		progress. Sub-tasks being performed in parallel aren't recorded; a
+		group is started again from scratch when resumed, and calling this from
+		within one does nothing.
+
+		@returns	true if a checkpoint was saved.
+	*/
+	bool saveCheckpoint ();
+
 	/** Set the current progress for this task. Note that this is only really
         safe to call from the context of the task itself.
      
@@ -104,11 +162,18 @@ public:
      */
 	void setStatusMessage (const juce::String& message);
 
-	/** Returns the status message set by setStatusMessage().
+	/** Returns this task's status message. This is the message set by
+        setStatusMessage(), unless a sub-task has set one more recently, in
+        which case it is the result of formatStatusMessageFromSubTask(). The
+        message is only built when this is called, so status updates within
+        a deep sub-task hierarchy stay cheap.
      */
 	juce::String getStatusMessage () const;
 
-	/** If called, this will cause shouldAbort to return true. 
+	/** If called, this will cause shouldAbort to return true. This is
+        passed on to all sub-tasks currently running under this one
+        (including any running in parallel), and is safe to call from any
+        thread.
      */
 	void abort ();
 
@@ -120,6 +185,13 @@ public:
      */
 	bool shouldAbort () const;
 
+	/** Returns the token which is cancelled when this task is aborted. For
+        very tight loops, checking this directly is even cheaper than calling
+        shouldAbort(), although it won't notice the thread being asked to
+        exit (shouldAbort() checks for that every few milliseconds).
+     */
+	const CancellationToken& getCancellationToken () const;
+
 	/** Perform the provided task immediately as a sub-task of this one, taking
         up the specified proportion of the overall progress. Note that this
         should only be called from within a task's run() function!
@@ -179,6 +251,39 @@ public:
      */
 	juce::Result performSubTaskSequence (const TaskSequence& sequence, double proportionOfProgress, bool stopOnError);
 
+	/** Perform all the tasks in the provided sequence concurrently, as sub-tasks
+        of this one. The calling thread runs sub-tasks itself, and additional
+        jobs are added to the provided pool so that its workers can help out;
+        this means that the sequence will still complete if all of the pool's
+        workers are busy (or if this task is itself running on that pool).
+     
+        Each sub-task gets its own ExecutionScope, and the overall progress of
+        the sequence is the weighted sum of the sub-tasks' progress. Aborting
+        this task aborts all of the sub-tasks currently running. Be aware that
+        this task's status and progress will be updated from whichever threads
+        the sub-tasks are running on, so the same is true for any
+        TaskContext::Listener callbacks.
+     
+        @param  sequence                The sequence of tasks to perform. The tasks
+                                        must all be independent of each other.
+        @param  proportionOfProgress    The proportion of the overall progress that 
+                                        this sequence as a whole should occupy.
+        @param  stopOnError             If true, no further sub-tasks will be started
+                                        once one has failed, any that are still
+                                        running will be aborted, and the result of
+                                        the failed task is returned. If false, all
+                                        tasks in the sequence will be run.
+        @param  pool                    The pool to use for extra worker threads.
+     
+        @returns    a value of Result::ok() if all of the tasks completed without
+                    any failures. Otherwise, the errors are combined in the same
+                    way as performSubTaskSequence().
+     
+        @see    performSubTaskSequence
+     */
+	juce::Result performSubTaskSequenceParallel (const TaskSequence& sequence, double proportionOfProgress,
+                                                 bool stopOnError, TaskThreadPool& pool);
+
 	/** Called just before a sub-task is started.
         @param  task                    The task that is starting.
         @param  index                   The index of the subtask. If this is not
@@ -192,7 +297,9 @@ public:
 
 	/** The result of this function is used to set this task's status message
         a sub-task's status changes. By default, it simply uses the subtask's message,
-        but you might want to prefix it with something else.
+        but you might want to prefix it with something else. This can be called
+        from any thread which asks for the overall status message (with the
+        context's status messages locked), so it mustn't lock the context.
      
         @param  subTask                 The subtask whose status message has changed.
      
@@ -208,6 +315,30 @@ public:
     
     static const juce::Result taskAlreadyRunning;
 
+protected:
+
+	/** Performs a set of sub-tasks concurrently, in the same way as
+        performSubTaskSequenceParallel(), except that a sub-task is not started
+        until all of the sub-tasks it depends on have finished. If a sub-task
+        fails (or is skipped), any sub-tasks depending on it are skipped.
+     
+        @param  tasks                   The sub-tasks to perform.
+        @param  dependentsOfTasks       For each task in the sequence, the indexes
+                                        of the tasks which depend on it. This must
+                                        not contain any cycles!
+        @param  proportionOfProgress    The proportion of the overall progress that 
+                                        the graph as a whole should occupy.
+        @param  stopOnError             If true, no further sub-tasks will be started
+                                        once one has failed.
+        @param  pool                    The pool to use for extra worker threads.
+     
+        @see    TaskGraph, performSubTaskSequenceParallel
+     */
+	juce::Result performSubTaskGraph (const TaskSequence& tasks, const juce::Array< juce::Array< int > >& dependentsOfTasks,
+                                      double proportionOfProgress, bool stopOnError, TaskThreadPool& pool);
+
+public:
+
     ///////////////////////////////////////////////////////////////////////////
     /**
         This wraps up the stuff used in the execution of a task.
@@ -228,30 +359,76 @@ public:
         void setProgress (double progress);
         void setStatusMessage (const juce::String& message);
 
+		/** Returns the status message for this scope, building it from the
+			active sub-task's message if that is more recent than our own.
+			This locks the context's status messages while it does so. */
+		juce::String getStatusMessage () const;
+
+		/** Returns the progress of this scope's task. While a sub-task is
+			running, this is worked out from the progress root's value. */
+		double getProgress () const;
+
 		double interpolateProgress (double amount) const;
 
+		/** Builds a checkpoint for this scope's task and its active sub-tasks. */
+		juce::var createCheckpoint () const;
+
     private:
 
 		JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ExecutionScope);
 
         ExecutionScope (TaskContext& executionContext, ProgressiveTask& task, ExecutionScope* parentScope = nullptr,
-						double proportionOfProgress = 1.0, int index = 0, int count = 1);
+						double proportionOfProgress = 1.0, int index = 0, int count = 1,
+						SubTaskGroup* group = nullptr, int call = 0);
 
         juce::Result performSubTask (ProgressiveTask& task, double proportion, int index, int count);
+
+		void restoreCheckpoint ();
+		int getSubTaskToResume (int call, int numSubTasks) const;
+
+		/** Returns the ordinal of the next sub-task call made from this scope.
+			A whole sequence counts as a single call, so that a checkpoint can
+			tell two calls apart even if they run sequences of the same size. */
+		int beginSubTaskCall ();
+
+		/** Tells whoever is watching this scope that its message has changed:
+			the parallel group it reports to, or else the context. */
+		void notifyStatusMessageChanged ();
         
         friend class ProgressiveTask;
 		friend class TaskContext;        
+		friend class SubTaskGroup;
 
         TaskContext& context;
         ProgressiveTask& task;
 		ExecutionScope* parentScope;
 		ExecutionScope* subTaskScope;
+		SubTaskGroup* group;		// the parallel group this scope reports to, if any
+		const ExecutionScope* groupStatusScope;	// the sub-task in a parallel group with the latest message, guarded by the context's statusMessageLock
+		int getLatestStatusMessageStamp () const;
+
 		juce::String statusMessage;
+		int statusMessageStamp;
 		double progress;
 		double progressAtStart;
 		double progressAtEnd;
+
+		// Progress updates are written straight to the progress root (the
+		// top-level scope, or the scope of a task in a parallel group), using
+		// rootProgress = rootOffset + rootScale * progress.
+		ExecutionScope* progressRoot;
+		double rootScale;
+		double rootOffset;
+
 		int index;
 		int count;
+		int call;				// the ordinal of the parent's sub-task call that this scope belongs to
+		int numSubTaskCalls;
+
+		juce::var checkpointToRestore;	// set before the task starts, if it's being resumed
+		juce::var subTaskCheckpoint;	// the checkpoint of the sub-task to resume
+		int subTaskToResume;
+		int subTaskCallToResume;
     };
 
     ///////////////////////////////////////////////////////////////////////////
@@ -265,10 +442,16 @@ public:
 private:
 
 	friend class TaskContext;        
+
+	juce::Result performSubTaskGroup (const TaskSequence& tasks, const juce::Array< juce::Array< int > >* dependentsOfTasks,
+                                      double proportionOfProgress, bool stopOnError, TaskThreadPool& pool);
+	juce::Result performSubTaskInCall (ProgressiveTask& taskToPerform, double proportionOfProgress,
+									   int index, int count, int call);
 	
 	juce::String name;
     ExecutionScope* scope;
-	bool abortSignal;
+	CancellationToken cancellationToken;
+	mutable juce::uint32 lastThreadCheckTime;
 	
 };
 
@@ -292,8 +475,7 @@ private:
 */
 ///////////////////////////////////////////////////////////////////////////
 
-class TaskContext	:	public juce::ReferenceCountedObject,
-						private juce::AsyncUpdater
+class TaskContext	:	public juce::ReferenceCountedObject
 {
 public:
 
@@ -317,6 +499,9 @@ public:
 		/** The task was aborted. */
 		taskAborted,
 
+		/** The task was aborted because its deadline passed. */
+		taskTimedOut,
+
 	};
 
 	typedef juce::ReferenceCountedObjectPtr< TaskContext > Ptr;
@@ -331,24 +516,198 @@ public:
 		will be destroyed automatically once it has been dispatched. */
 	void addCallback (ProgressiveTask::Callback* callback);
 
+	/** Sets the dispatcher used to run this context's completion callbacks
+		and to delete it. This must be set before the task is run. By default
+		this is TaskDispatcher::getDefault(). */
+	void setDispatcher (TaskDispatcher& newDispatcher);
+
+	/** Returns the dispatcher used for this context's completion callbacks. */
+	TaskDispatcher& getDispatcher () const;
+
+	/** Sets a cache to look for the task's result in before running it, and
+		to store the result in afterwards (see ProgressiveTask::getCacheKey()).
+		The context doesn't own the cache. */
+	void setResultCache (TaskResultCache* cache);
+
+	/** Returns the cache used by this context, if any. */
+	TaskResultCache* getResultCache () const;
+
+	/** Returns true if the task's result came from the cache, rather than
+		from running it. */
+	bool wasResultCached () const;
+
+	/** If the task's result is in the cache, this completes the context on
+		the calling thread straight away, without running the task.
+
+		@returns	true if the result was cached.
+	*/
+	bool runFromCache ();
+
+	/** Sets a checkpoint (as saved by ProgressiveTask::saveCheckpoint()) for
+		the task to continue from, rather than starting from scratch. This must
+		be set before the task is run. */
+	void setCheckpointToResume (const juce::var& checkpoint);
+
+	/** Sets a file which checkpoints are written to (as JSON) whenever the task
+		saves one. If the file exists when the task starts, and no checkpoint
+		has been set with setCheckpointToResume(), the task continues from the
+		checkpoint in the file. It is deleted when the task finishes, unless it
+		was aborted. */
+	void setCheckpointFile (const juce::File& file);
+
+	/** Returns the checkpoint most recently saved by the task, or a void var
+		if it hasn't saved one. */
+	juce::var getLastCheckpoint () const;
+
+	/** Sets a time by which the task should have finished. If it's still
+		running when the deadline passes, it's aborted by the TaskWatchdog,
+		and ends up in the taskTimedOut state. As with any abort, the task
+		has to notice (via shouldAbort(), or by waiting on its
+		CancellationToken) before it actually stops; a suspended ResumableTask
+		is woken straight away (see setWakeUpHandler()), rather than at the
+		end of its sleep or wait. If the deadline has already passed
+		when the task is started, it isn't run at all.
+
+		This must be set before the task is run.
+	*/
+	void setDeadline (juce::Time deadline);
+
+	/** Sets a deadline relative to when the task starts, limiting how long it
+		can run for (see setDeadline()). If both are set, whichever comes first
+		applies. This must be set before the task is run. */
+	void setTimeout (int milliseconds);
+
+	/** Returns true if the task was aborted because its deadline passed. */
+	bool hasTimedOut () const;
+
+    ///////////////////////////////////////////////////////////////////////
+    /**
+        Decides what (if anything) should run on a pool once a task has
+        finished. See TaskContext::then().
+    */
+    ///////////////////////////////////////////////////////////////////////
+
+	class Continuation
+	{
+	public:
+		virtual ~Continuation () {}
+
+		/** Called from the thread which ran the predecessor, as soon as it
+			has finished (before any Callbacks are dispatched). The
+			predecessor's result is available from its getResult() and
+			wasAborted() functions.
+
+			@returns	a new task to add to the pool, or nullptr if nothing
+						should run.
+		*/
+		virtual ProgressiveTask* createNextTask (TaskContext& predecessor) = 0;
+	};
+
+    ///////////////////////////////////////////////////////////////////////
+
+	/** Adds a task to be run on a pool as soon as this one has finished,
+		without waiting for the message thread. If this task has already
+		finished, the next one is added to the pool straight away.
+
+		@param	nextTask			The task to run next. The returned context
+									takes ownership of it.
+		@param	pool				The pool to run the next task on.
+		@param	onlyIfSucceeded		If true, the next task is only run if this
+									one completed successfully. Otherwise its
+									context finishes as aborted without being
+									run, so its callbacks (and any stages
+									chained onto it) still get called.
+		@returns	the context for the next task, so that further stages can
+					be chained onto it. Its getPredecessorResult() gives the
+					result of this task.
+	*/
+	TaskContext& then (ProgressiveTask* nextTask, TaskThreadPool& pool, bool onlyIfSucceeded = true);
+
+	/** Adds a Continuation, which decides what to run on the pool once this
+		task has finished. The context takes ownership of the continuation. */
+	void then (Continuation* continuation, TaskThreadPool& pool);
+
+	/** For a context created by then(), returns the result of the task it
+		was chained onto. Otherwise, this is always Result::ok(). */
+	juce::Result getPredecessorResult () const;
+
 	/** Returns the task this context is responsible for. */
 	ProgressiveTask& getTask ();
 
+	/** Sets an identifier for this context, which can be used to find or
+		remove it from a TaskThreadPool. This should be set before the
+		context is added to a pool. */
+	void setId (const juce::Identifier& newId);
+
+	/** Returns the identifier given to this context, if any. */
+	juce::Identifier getId () const;
+
 	/** Returns the result of this task's execution (if it has finished). */
 	juce::Result getResult () const;
 
-	/** Returns true if the task was aborted. */
+	/** Returns true if the task was aborted (including if it timed out). */
 	bool wasAborted () const;
 
 	/** Returns the current state of the context. */
 	TaskState getState () const;
 
-	/** Returns true if the task has completed (or was aborted). */
+	/** Returns true if the task has completed (or was aborted, or timed out). */
 	bool hasFinished () const;
 
+	/** Returns true if this is a ResumableTask which has been started, but
+		is currently waiting between steps without occupying a thread. The
+		context's state stays as taskRunning while it is suspended. */
+	bool isSuspended () const;
+
+    ///////////////////////////////////////////////////////////////////////
+    /**
+        Given to a suspended context by whatever is holding it between steps
+        (see setWakeUpHandler()), so that the task can be resumed early if its
+        deadline passes while it's waiting.
+    */
+    ///////////////////////////////////////////////////////////////////////
+
+	class WakeUpHandler	:	public juce::ReferenceCountedObject
+	{
+	public:
+
+		typedef juce::ReferenceCountedObjectPtr< WakeUpHandler > Ptr;
+
+		virtual ~WakeUpHandler () {}
+
+		/** Puts the task back in a queue, so that it can see that it has been
+			aborted and finish. This may be called from any thread (including
+			the TaskWatchdog's), and may be called more than once. */
+		virtual void wakeUp () = 0;
+	};
+
+	/** Sets the handler used to wake the task up if it times out while it is
+		suspended. This is cleared when the task is next run. If the task has
+		already been aborted, the handler is called straight away. */
+	void setWakeUpHandler (WakeUpHandler* handler);
+
+    ///////////////////////////////////////////////////////////////////////
+
 	/** Helper to get a string describing the current state. */
 	juce::String getStateDescription () const;
 
+	/** Returns the overall progress of the task, as most recently published
+		by its ExecutionScope hierarchy. This doesn't need the context's lock,
+		so it's safe (and cheap) to call from any thread at any time. */
+	double getOverallProgress () const;
+
+	/** Returns the overall status message of the task. The message is only
+		built the first time it is asked for after a status change, and is
+		cached until the next change, so repeated calls are cheap. This only
+		takes the lock guarding the scopes' status messages (never the
+		context's own lock), so it's safe to call from any thread. */
+	juce::String getOverallStatusMessage () const;
+
+	/** Returns a counter which is incremented every time the overall progress
+		or status message is published. Comparing this with a previously read
+		value is a cheap way to find out whether anything needs redrawing. */
+	int getUpdateCount () const;
+
     ///////////////////////////////////////////////////////////////////////
     /**
         Listener class for receiving notifications from the active task
@@ -368,6 +727,8 @@ public:
 		/**
 			Called when a task context's execution state changes.
 			Note that this is called from the context's execution thread!
+			The context isn't locked during the call, so its state may
+			already have moved on by the time this is called.
 		*/
 		virtual void taskStateChanged (TaskContext&) {};
 
@@ -384,17 +745,55 @@ public:
         virtual void taskProgressChanged (TaskContext& task) = 0;
 
 		/**
-			This is called (from the message thread) just before any
-			registered Task::Callback objects are dispatched, after the
-			task has finished.
+			This is called (from the context's TaskDispatcher, which is the
+			message thread by default) just before any registered
+			Task::Callback objects are dispatched, after the task has finished.
 		*/
 		virtual void aboutToDispatchTaskFinishedCallbacks (TaskContext&) {};
 
 		/**
-			This is called (from the message thread) after all of the
-			registered Task::Callback objects have been dispatched.
+			This is called (from the context's TaskDispatcher) after all of
+			the registered Task::Callback objects have been dispatched.
 		*/
 		virtual void taskFinishedCallbacksDispatched (TaskContext&) {};
+
+		/**
+			Called when the task has saved a checkpoint, which can be retrieved
+			with getLastCheckpoint(). Note that this is called from the
+			context's execution thread!
+		*/
+		virtual void taskCheckpointSaved (TaskContext&) {};
+    };
+
+    ///////////////////////////////////////////////////////////////////////
+    /**
+        Describes how often a Listener should be told about progress and
+        status message changes. The default policy passes on every change.
+    */
+    ///////////////////////////////////////////////////////////////////////
+
+    struct NotificationPolicy
+    {
+        /** Creates a policy.
+         
+            @param maxRateHz            The maximum number of progress (and
+                                        separately, status) notifications per
+                                        second, or zero for no limit.
+            @param minProgressDelta     The minimum change in progress since the
+                                        last notification for it to be worth
+                                        sending another, or zero for any change.
+            @param coalesce             If true, a change which is held back by
+                                        the policy is remembered and delivered
+                                        with the next notification that is let
+                                        through, or when the task stops; the
+                                        listener will always see the final value.
+                                        If false, held back changes are dropped.
+         */
+        NotificationPolicy (double maxRateHz = 0.0, double minProgressDelta = 0.0, bool coalesce = true);
+
+        double maxRateHz;
+        double minProgressDelta;
+        bool coalesce;
     };
 
     ///////////////////////////////////////////////////////////////////////
@@ -405,8 +804,20 @@ public:
 
     /// Register a listener for tasks on this context.
     void addListener (Listener* listener);
+
+    /// Register a listener, limiting how often it will be notified of progress
+    /// and status message changes.
+    void addListener (Listener* listener, const NotificationPolicy& policy);
     
-    /// Remove a listener from this context.
+    /// Remove a listener from this context. If the listener is being called
+    /// on another thread, this waits for that call to return, so the
+    /// listener won't be called again once this has returned.
+    ///
+    /// Because of that wait, a listener callback must never block on the
+    /// thread that removes it. For example, if a callback uses
+    /// MessageManager::callFunctionOnMessageThread(), the listener mustn't
+    /// be removed from the message thread while the task is running. A
+    /// listener may still remove itself from within its own callback.
     void removeListener (Listener* listener);
 
     /** Returns this context's lock, allowing you to ensure that the active
@@ -414,32 +825,115 @@ public:
         it. */
     const juce::CriticalSection& getLock () const { return runtimeLock; }
 
+	/** If the task has finished but its completion callbacks haven't been
+		dispatched yet, this dispatches them immediately. */
 	void flush ();
 
+	/** Deletes a context using its dispatcher. This is used as the context's
+		ContainerDeletePolicy, so you shouldn't need to call it. */
+	static void destroy (TaskContext* context);
+
+	/** Contexts are created for every task that gets run, so their memory is
+		recycled rather than going back to the heap each time. */
+	static void* operator new (size_t size);
+	static void operator delete (void* block, size_t size);
+
 private:
 
-	void handleAsyncUpdate () override;
+	class FinishedCallbacksWork;
+	void dispatchFinishedCallbacks ();
+
+	class PendingContinuation;
+	void addContinuation (PendingContinuation* continuation);
+	void runContinuation (PendingContinuation& continuation);
+	void runContinuations ();
 
 	//void flushCallbacks (bool aborted);
 	void setState (TaskState state);
 
+	void publishProgress (double progress);
+	void statusMessageChanged ();
+
+	typedef void (Listener::*ListenerCallback) (TaskContext&);
+	void callListeners (ListenerCallback callback);
+	void notifyProgressChanged ();
+	void notifyStatusMessageChanged ();
+	void flushPendingNotifications ();
+
 	juce::Result runTask (TaskThreadBase& threadBase);
+	juce::Result runStep (TaskThreadBase& threadBase, ResumableTask& task);
+	void abortSuspendedTask ();
+
+	bool lookUpCachedResult (juce::Result& cachedResult, juce::var& payload);
+	void applyCachedResult (const juce::Result& cachedResult, const juce::var& payload);
+	void storeResultInCache ();
+
+	bool saveCheckpoint ();
+	void restoreCheckpoint (ProgressiveTask::ExecutionScope& rootScope);
+	void discardCheckpoint ();
+
+	class DeadlineTimeout;
+	bool startDeadline ();
+	void stopDeadline ();
+	void deadlineExpired ();
 
+    friend class ProgressiveTask;
     friend class ProgressiveTask::ExecutionScope;
 	friend class TaskThreadBase;
 	class ScopedRunTime;
+	class ListenerEntry;
+	class ListenerSnapshot;
+
+	juce::ReferenceCountedObjectPtr< ListenerSnapshot > getListeners () const;
+	void setListeners (ListenerSnapshot* newListeners);
 
 	juce::CriticalSection runtimeLock;
+	TaskDispatcher* dispatcher;
+	juce::Atomic< int > finishedCallbacksPending;
 	TaskThreadBase* taskThread;
+	juce::Identifier id;
 	juce::Result result;
+	juce::Result predecessorResult;
+	juce::OwnedArray<PendingContinuation> continuations;
 	juce::ScopedPointer<ProgressiveTask> activeTask;
 	juce::OwnedArray<ProgressiveTask::Callback> callbacks;
-    juce::ListenerList<Listener> listeners;
+	juce::ReferenceCountedObjectPtr< ListenerSnapshot > listeners;	// guarded by listenersLock
+	juce::SpinLock listenersLock;
+	juce::CriticalSection listenerWriteLock;
 	TaskState currentState;
+	bool suspended;
+	double suspendedProgress;
+	TaskResultCache* resultCache;
+	bool resultCacheChecked;
+	bool resultWasCached;
+	juce::var checkpointToResume;
+	juce::var lastCheckpoint;	// guarded by runtimeLock
+	juce::File checkpointFile;
+	juce::Time deadline;
+	int timeoutMs;
+	juce::Atomic< int > timedOut;
+	juce::ScopedPointer< DeadlineTimeout > deadlineTimeout;
+	WakeUpHandler::Ptr wakeUpHandler;	// guarded by runtimeLock
+
+	juce::Atomic<double> overallProgress;
+	juce::Atomic<int> updateCount;
+	juce::Atomic<int> statusMessageStamp;
+	juce::CriticalSection statusMessageLock;	// guards the scopes' messages and links, and the cached message
+	mutable juce::String overallStatusMessage;
+	mutable int overallStatusMessageStamp;
 
 };
 
-DECLARE_MESSAGETHREAD_DELETE_POLICY(TaskContext);
+/** Contexts are deleted by their TaskDispatcher (on the message thread, by
+	default) when their last reference is released. */
+template <>
+struct juce::ContainerDeletePolicy< TaskContext >
+{
+	static void destroy (TaskContext* context)
+	{
+		TaskContext::destroy (context);
+	}
+};
 
 ///////////////////////////////////////////////////////////////////////////////
 /**
@@ -462,6 +956,14 @@ public:
 		the thread that this object represents. */
 	void runTask (TaskContext::Ptr taskContext);
 
+	/** Marks a context which was given to a thread (or a queue), but is now
+		never going to be run, as aborted. This means that its completion
+		callbacks and continuations still happen, and anything waiting for it
+		to finish isn't left hanging. A ResumableTask which is suspended
+		between steps is finished with its getAbortResult(). Otherwise, this
+		does nothing if the task has already started. */
+	static void abortTask (TaskContext::Ptr taskContext);
+
 	/** This must return true if the current task needs to exit. */
 	virtual bool currentTaskShouldExit () = 0;
 
@@ -469,8 +971,37 @@ public:
 		is representing. */
 	virtual bool isCurrentTaskThread () = 0;
 
+	/** Return true if a ResumableTask may be left suspended when runTask()
+		returns, in which case the caller is responsible for running the
+		context again once its task is ready to continue (see
+		ResumableTask::getPendingStep()). By default, a ResumableTask is
+		simply run to completion, blocking this thread while it waits. */
+	virtual bool canSuspendTasks () { return false; }
+
+private:
+
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/**
+	Runs a context straight away on the calling thread, which is blocked
+	until the task has finished. The task is never asked to exit (other than
+	by aborting it).
+*/
+///////////////////////////////////////////////////////////////////////////////
+
+class InlineTaskRunner	:	public TaskThreadBase
+{
+public:
+
+	InlineTaskRunner () {}
+
+	virtual bool currentTaskShouldExit () override	{ return false; }
+	virtual bool isCurrentTaskThread () override	{ return true; }
+
 private:
 
+	JUCE_DECLARE_NON_COPYABLE (InlineTaskRunner);
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -492,6 +1023,11 @@ public:
 	void setTaskContext (TaskContext* taskToView, bool alsoTriggerRefresh = true);
 	TaskContext* getTaskContext ();
 
+	/** Sets the policy used to throttle progress and status notifications
+		when this is registered with a TaskContext. This takes effect the
+		next time a context is assigned. */
+	void setNotificationPolicy (const TaskContext::NotificationPolicy& newPolicy);
+
 	/** Called when a new TaskContext is assigned to this object. */
 	virtual void taskContextChanged ();
 
@@ -527,6 +1063,7 @@ private:
 
 	TaskContext::Ptr task;
 	juce::ScopedPointer<AsyncRefresh> refreshCallback;
+	TaskContext::NotificationPolicy notificationPolicy;
 
 };
 
@@ -0,0 +1,92 @@
+
+///////////////////////////////////////////////////////////////////////////////
+
+ResumableTask::Step::Step ()
+	:	type (finishedStep),
+		result (Result::ok()),
+		sleepTime (0)
+{
+}
+
+ResumableTask::Step::Step (Type type_, const Result& result_, int sleepTime_, TaskContext* context_)
+	:	type (type_),
+		result (result_),
+		sleepTime (sleepTime_),
+		context (context_)
+{
+}
+
+ResumableTask::Step ResumableTask::Step::finished (const Result& result)
+{
+	return Step (finishedStep, result, 0, nullptr);
+}
+
+ResumableTask::Step ResumableTask::Step::yield ()
+{
+	return Step (yieldStep, Result::ok(), 0, nullptr);
+}
+
+ResumableTask::Step ResumableTask::Step::sleep (int milliseconds)
+{
+	return Step (sleepStep, Result::ok(), jmax (0, milliseconds), nullptr);
+}
+
+ResumableTask::Step ResumableTask::Step::waitFor (TaskContext* contextToWaitFor)
+{
+	jassert (contextToWaitFor != nullptr);
+	return Step (waitStep, Result::ok(), 0, contextToWaitFor);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+ResumableTask::ResumableTask (const String& name)
+	:	ProgressiveTask (name)
+{
+}
+
+ResumableTask::~ResumableTask ()
+{
+}
+
+const ResumableTask::Step& ResumableTask::getPendingStep () const
+{
+	return pendingStep;
+}
+
+Result ResumableTask::run ()
+{
+	for (;;)
+	{
+		pendingStep = resume ();
+
+		if (pendingStep.isFinished ())
+			return pendingStep.getResult ();
+
+		if (shouldAbort ())
+			return getAbortResult ();
+
+		switch (pendingStep.getType ())
+		{
+		case Step::sleepStep:
+			{
+				// Sleep in short slices so that an abort is noticed quickly.
+				const uint32 wakeTime = Time::getMillisecondCounter () + (uint32) pendingStep.getSleepTime ();
+
+				while (Time::getMillisecondCounter () < wakeTime && ! shouldAbort ())
+					Thread::sleep (jmin (10, (int) (wakeTime - Time::getMillisecondCounter ())));
+			}
+			break;
+
+		case Step::waitStep:
+
+			while (! pendingStep.getContextToWaitFor ()->hasFinished () && ! shouldAbort ())
+				Thread::sleep (5);
+			break;
+
+		default:
+			break;
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
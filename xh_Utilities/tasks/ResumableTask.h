@@ -0,0 +1,102 @@
+#ifndef RESUMABLETASK_H_INCLUDED
+#define RESUMABLETASK_H_INCLUDED
+
+///////////////////////////////////////////////////////////////////////////////
+/**
+	A task whose work is split into a series of steps, so that it can wait
+	(for a time, or for another task) without occupying a thread.
+
+	Rather than implementing run(), a subclass implements resume(), which
+	performs the next piece of work and returns a Step saying what should
+	happen next. Any state that must survive between steps is kept in member
+	variables. Within a step, setProgress(), setStatusMessage(),
+	shouldAbort() and performSubTask() all behave as they do in run().
+
+	When added to a TaskThreadPool, the task is taken off its worker between
+	steps, and put back into the pool's queue once it's ready to continue,
+	so lots of mostly-waiting tasks can share a small number of workers.
+	When run by anything else, the waits simply block the running thread.
+*/
+///////////////////////////////////////////////////////////////////////////////
+
+class ResumableTask	:	public ProgressiveTask
+{
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ResumableTask);
+public:
+
+    ///////////////////////////////////////////////////////////////////////
+    /** Describes what a ResumableTask wants to do after a call to resume(). */
+    ///////////////////////////////////////////////////////////////////////
+
+	class Step
+	{
+	public:
+
+		enum Type
+		{
+			finishedStep,
+			yieldStep,
+			sleepStep,
+			waitStep
+		};
+
+		/** The task has finished, with the given result. */
+		static Step finished (const juce::Result& result = juce::Result::ok());
+
+		/** The task wants to continue as soon as possible, but is happy to
+			let other tasks run first. */
+		static Step yield ();
+
+		/** The task wants to continue after the given time has passed. */
+		static Step sleep (int milliseconds);
+
+		/** The task wants to continue once another context has finished.
+			The context may be running on any pool (or thread). */
+		static Step waitFor (TaskContext* contextToWaitFor);
+
+		Step ();
+
+		Type getType () const						{ return type; }
+		bool isFinished () const					{ return type == finishedStep; }
+		const juce::Result& getResult () const		{ return result; }
+		int getSleepTime () const					{ return sleepTime; }
+		TaskContext* getContextToWaitFor () const	{ return context; }
+
+	private:
+
+		Step (Type type, const juce::Result& result, int sleepTime, TaskContext* context);
+
+		Type type;
+		juce::Result result;
+		int sleepTime;
+		TaskContext::Ptr context;
+	};
+
+    ///////////////////////////////////////////////////////////////////////
+
+	ResumableTask (const juce::String& name);
+	virtual ~ResumableTask ();
+
+	/** Performs the next step of the task. This is called repeatedly until
+		it returns Step::finished(). Once the task has been aborted, it is
+		never suspended again; if resume() asks to wait, the task finishes
+		as aborted instead, with the result of getAbortResult(). */
+	virtual Step resume () = 0;
+
+	/** Returns what the task asked to do after its last step. */
+	const Step& getPendingStep () const;
+
+	/** Runs all of the steps on the calling thread. This is what happens
+		when the task is run by a thread which can't suspend it. */
+	virtual juce::Result run () override;
+
+private:
+
+	Step pendingStep;
+
+	friend class TaskContext;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif  // RESUMABLETASK_H_INCLUDED
@@ -57,3 +57,97 @@ Result SerialTask::run ()
 }
 
 ///////////////////////////////////////////////////////////////////////////////
+
+class SerialTaskTests	:	public UnitTest
+{
+public:
+
+	SerialTaskTests () : UnitTest ("SerialTask") {}
+
+	virtual void runTest ()
+	{
+		beginTest ("Progress through nested sequences");
+
+		SerialTask* outer = new SerialTask ("Outer");
+
+		for (int i = 0; i < 3; ++i)
+		{
+			SerialTask* inner = new SerialTask ("Inner");
+
+			for (int j = 0; j < 3; ++j)
+				inner->addTask (new SteppingTask (4), 1.0 + j);
+
+			outer->addTask (inner, 1.0 + i);
+		}
+
+		outer->addTask (new SteppingTask (4));
+
+		InlineTaskDispatcher dispatcher;
+		ProgressRecorder recorder;
+		{
+			TaskContext::Ptr context (new TaskContext (outer));
+			context->setDispatcher (dispatcher);
+			context->addListener (&recorder);
+
+			InlineTaskRunner runner;
+			runner.runTask (context);
+
+			context->removeListener (&recorder);
+			expect (context->getResult ().wasOk ());
+		}
+
+		expect (recorder.values.size () > 0);
+
+		for (int i = 1; i < recorder.values.size (); ++i)
+		{
+			expect (recorder.values.getUnchecked (i) >= recorder.values.getUnchecked (i - 1),
+					"Progress went backwards at update " + String (i));
+		}
+
+		expect (std::abs (recorder.values.getLast () - 1.0) < 1.0e-9);
+	}
+
+private:
+
+	/** Sets its progress in a number of equal steps. */
+	class SteppingTask	:	public ProgressiveTask
+	{
+	public:
+
+		SteppingTask (int numSteps_)
+			:	ProgressiveTask ("Stepping task"),
+				numSteps (numSteps_)
+		{
+		}
+
+		virtual Result run () override
+		{
+			for (int i = 1; i <= numSteps; ++i)
+				setProgress ((double) i / numSteps);
+
+			return Result::ok ();
+		}
+
+	private:
+
+		const int numSteps;
+	};
+
+	class ProgressRecorder	:	public TaskContext::Listener
+	{
+	public:
+
+		virtual void taskStatusMessageChanged (TaskContext&) override	{}
+
+		virtual void taskProgressChanged (TaskContext& context) override
+		{
+			values.add (context.getOverallProgress ());
+		}
+
+		Array< double > values;
+	};
+};
+
+static SerialTaskTests serialTaskTests;
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,240 @@
+
+///////////////////////////////////////////////////////////////////////////////
+
+static TaskDispatcher* defaultTaskDispatcher = nullptr;
+
+// Big enough for the work dispatched for every task (which holds a single
+// pointer); anything larger just goes to the heap.
+typedef RecyclingAllocator< 4 * sizeof (void*) > TaskWorkAllocator;
+
+void* TaskDispatcher::Work::operator new (size_t size)
+{
+	return TaskWorkAllocator::allocate (size);
+}
+
+void TaskDispatcher::Work::operator delete (void* block, size_t size)
+{
+	TaskWorkAllocator::deallocate (block, size);
+}
+
+void TaskDispatcher::deleteContext (TaskContext* context)
+{
+	class DeleteWork	:	public Work
+	{
+	public:
+		DeleteWork (TaskContext* context_) : context (context_) {}
+		virtual void run () override	{ delete context; }
+		TaskContext* context;
+	};
+
+	if (isDispatchThread ())
+		delete context;
+	else
+		dispatch (new DeleteWork (context));
+}
+
+TaskDispatcher& TaskDispatcher::getDefault ()
+{
+	if (defaultTaskDispatcher != nullptr)
+		return *defaultTaskDispatcher;
+
+	return MessageThreadTaskDispatcher::getInstance ();
+}
+
+void TaskDispatcher::setDefault (TaskDispatcher* newDefault)
+{
+	defaultTaskDispatcher = newDefault;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+class MessageThreadTaskDispatcher::BatchMessage	:	public CallbackMessage
+{
+public:
+
+	BatchMessage (MessageThreadTaskDispatcher& owner_) : owner (owner_) {}
+
+	virtual void messageCallback () override
+	{
+		owner.runBatch ();
+	}
+
+private:
+
+	MessageThreadTaskDispatcher& owner;
+};
+
+MessageThreadTaskDispatcher::MessageThreadTaskDispatcher (double timeBudgetMilliseconds)
+	:	queueStart (0),
+		timeBudget (timeBudgetMilliseconds)
+{
+}
+
+MessageThreadTaskDispatcher::~MessageThreadTaskDispatcher ()
+{
+	ScopedLock sl (lock);
+
+	for (int i = queueStart; i < queue.size(); ++i)
+		delete queue.getUnchecked (i);
+}
+
+void MessageThreadTaskDispatcher::dispatch (Work* work)
+{
+	{
+		ScopedLock sl (lock);
+		queue.add (work);
+	}
+
+	// Only one message is needed for however much work gets queued before
+	// it's delivered.
+	if (messagePending.compareAndSetBool (1, 0))
+		(new BatchMessage (*this))->post ();
+}
+
+void MessageThreadTaskDispatcher::setTimeBudget (double milliseconds)
+{
+	timeBudget = milliseconds;
+}
+
+int MessageThreadTaskDispatcher::getNumQueued () const
+{
+	ScopedLock sl (lock);
+	return queue.size() - queueStart;
+}
+
+void MessageThreadTaskDispatcher::runBatch ()
+{
+	const double deadline = Time::getMillisecondCounterHiRes () + timeBudget;
+
+	for (;;)
+	{
+		ScopedPointer< Work > work;
+
+		{
+			ScopedLock sl (lock);
+
+			if (queueStart >= queue.size())
+			{
+				// This is cleared with the lock held, so anything queued after
+				// this point will post a new message.
+				queue.clearQuick ();
+				queueStart = 0;
+				messagePending.set (0);
+				return;
+			}
+
+			work = queue.getUnchecked (queueStart++);
+		}
+
+		work->run ();
+		work = nullptr;
+
+		if (Time::getMillisecondCounterHiRes () >= deadline)
+		{
+			// Out of time, so carry on with the rest later. The work that
+			// has already run is dropped from the front of the queue, or it
+			// would keep growing while new work keeps arriving.
+			{
+				ScopedLock sl (lock);
+				queue.removeRange (0, queueStart);
+				queueStart = 0;
+			}
+
+			(new BatchMessage (*this))->post ();
+			return;
+		}
+	}
+}
+
+bool MessageThreadTaskDispatcher::isDispatchThread () const
+{
+	const MessageManager* messageManager = MessageManager::getInstanceWithoutCreating ();
+	return messageManager != nullptr && messageManager->isThisTheMessageThread ();
+}
+
+void MessageThreadTaskDispatcher::deleteContext (TaskContext* context)
+{
+	if (isDispatchThread ())
+		delete context;
+	else
+		deleteOnMessageThread (context);
+}
+
+MessageThreadTaskDispatcher& MessageThreadTaskDispatcher::getInstance ()
+{
+	static MessageThreadTaskDispatcher instance;
+	return instance;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void InlineTaskDispatcher::dispatch (Work* work)
+{
+	ScopedPointer< Work > workToRun (work);
+	workToRun->run ();
+}
+
+bool InlineTaskDispatcher::isDispatchThread () const
+{
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+ThreadTaskDispatcher::ThreadTaskDispatcher (const String& threadName)
+	:	Thread (threadName)
+{
+	startThread ();
+}
+
+ThreadTaskDispatcher::~ThreadTaskDispatcher ()
+{
+	signalThreadShouldExit ();
+	notify ();
+	stopThread (-1);
+}
+
+void ThreadTaskDispatcher::dispatch (Work* work)
+{
+	{
+		ScopedLock sl (lock);
+		queue.add (work);
+	}
+	notify ();
+}
+
+bool ThreadTaskDispatcher::isDispatchThread () const
+{
+	return Thread::getCurrentThreadId () == getThreadId ();
+}
+
+void ThreadTaskDispatcher::run ()
+{
+	for (;;)
+	{
+		ScopedPointer< Work > work;
+
+		{
+			ScopedLock sl (lock);
+
+			if (queue.size() > 0)
+				work = queue.removeAndReturn (0);
+		}
+
+		if (work != nullptr)
+		{
+			work->run ();
+		}
+		else if (threadShouldExit ())
+		{
+			// Only stop once the queue is empty, so no work is lost.
+			break;
+		}
+		else
+		{
+			wait (-1);
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,168 @@
+#ifndef TASKDISPATCHER_H_INCLUDED
+#define TASKDISPATCHER_H_INCLUDED
+
+class TaskContext;
+
+///////////////////////////////////////////////////////////////////////////////
+/**
+	Decides where a TaskContext's completion callbacks are run, and where the
+	context itself is deleted once it is no longer referenced.
+
+	By default everything goes to the message thread (see
+	MessageThreadTaskDispatcher), which is what a GUI application wants. An
+	application without a message loop (e.g. a command line tool or a server)
+	can use one of the other dispatchers instead, either for all contexts
+	(via setDefault()) or for individual ones (via TaskContext::setDispatcher()).
+
+	A dispatcher must outlive every context which uses it.
+*/
+///////////////////////////////////////////////////////////////////////////////
+
+class TaskDispatcher
+{
+public:
+
+	///////////////////////////////////////////////////////////////////////////
+
+	/** A piece of work to be run by a dispatcher. */
+	class Work
+	{
+	public:
+		virtual ~Work () {}
+		virtual void run () = 0;
+
+		/** Work is dispatched every time a task finishes (and usually again
+			when its context is deleted), so the memory of small work objects
+			is recycled rather than going back to the heap each time. */
+		static void* operator new (size_t size);
+		static void operator delete (void* block, size_t size);
+	};
+
+	///////////////////////////////////////////////////////////////////////////
+
+	TaskDispatcher () {}
+	virtual ~TaskDispatcher () {}
+
+	/** Runs a piece of work on the dispatcher's thread (either now, or at some
+		point soon), and then deletes it. This can be called from any thread. */
+	virtual void dispatch (Work* work) = 0;
+
+	/** Returns true if the calling thread is one this dispatcher runs its work
+		on, in which case it's fine to do that work directly. */
+	virtual bool isDispatchThread () const = 0;
+
+	/** Deletes a context which is no longer referenced. By default, this does
+		it immediately if called from a dispatch thread, and dispatches it
+		otherwise. */
+	virtual void deleteContext (TaskContext* context);
+
+	/** Returns the dispatcher given to new TaskContexts. */
+	static TaskDispatcher& getDefault ();
+
+	/** Sets the dispatcher given to new TaskContexts. Passing nullptr restores
+		the message thread dispatcher. */
+	static void setDefault (TaskDispatcher* newDefault);
+
+private:
+
+	JUCE_DECLARE_NON_COPYABLE (TaskDispatcher);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/**
+	Runs work on the message thread. This is the default dispatcher.
+
+	Work is queued and run in batches, so lots of tasks finishing at once
+	only post a single message. Each batch stops once it has used up the
+	time budget, and the rest of the queue is picked up by a later message,
+	so that a burst of completions doesn't hold up the message loop.
+*/
+///////////////////////////////////////////////////////////////////////////////
+
+class MessageThreadTaskDispatcher	:	public TaskDispatcher
+{
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MessageThreadTaskDispatcher);
+public:
+
+	MessageThreadTaskDispatcher (double timeBudgetMilliseconds = 5.0);
+	virtual ~MessageThreadTaskDispatcher ();
+
+	virtual void dispatch (Work* work) override;
+	virtual bool isDispatchThread () const override;
+	virtual void deleteContext (TaskContext* context) override;
+
+	/** Sets how long each batch may spend running work before it gives the
+		message loop a chance to do something else. At least one piece of
+		work is always run per batch. */
+	void setTimeBudget (double milliseconds);
+
+	/** Returns the number of pieces of work waiting to be run. */
+	int getNumQueued () const;
+
+	/** Returns the shared instance. */
+	static MessageThreadTaskDispatcher& getInstance ();
+
+private:
+
+	class BatchMessage;
+	void runBatch ();
+
+	juce::CriticalSection lock;
+	juce::Array< Work* > queue;		// guarded by lock
+	int queueStart;					// guarded by lock
+	juce::Atomic< int > messagePending;
+	double timeBudget;
+
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/**
+	Runs work immediately, on whichever thread dispatches it. For a task run
+	on a pool, this means its completion callbacks are run by the worker that
+	finished it, so they must be thread-safe.
+*/
+///////////////////////////////////////////////////////////////////////////////
+
+class InlineTaskDispatcher	:	public TaskDispatcher
+{
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(InlineTaskDispatcher);
+public:
+
+	InlineTaskDispatcher () {}
+
+	virtual void dispatch (Work* work) override;
+	virtual bool isDispatchThread () const override;
+
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/**
+	Runs work in order on a dedicated thread of its own. Any work which is
+	still queued when this is deleted is run before its thread stops.
+*/
+///////////////////////////////////////////////////////////////////////////////
+
+class ThreadTaskDispatcher	:	public TaskDispatcher,
+								private juce::Thread
+{
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ThreadTaskDispatcher);
+public:
+
+	ThreadTaskDispatcher (const juce::String& threadName = "Task dispatcher");
+	virtual ~ThreadTaskDispatcher ();
+
+	virtual void dispatch (Work* work) override;
+	virtual bool isDispatchThread () const override;
+
+private:
+
+	virtual void run () override;
+
+	juce::CriticalSection lock;
+	juce::OwnedArray< Work > queue;
+
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif//TASKDISPATCHER_H_INCLUDED
@@ -0,0 +1,253 @@
+///////////////////////////////////////////////////////////////////////////////
+
+TaskGraph::TaskGraph (const String& taskName, TaskThreadPool& poolToUse, bool stopOnSubTaskError)
+	:	ProgressiveTask (taskName),
+		pool (poolToUse),
+		stopOnError (stopOnSubTaskError)
+{
+
+}
+
+TaskGraph::~TaskGraph ()
+{
+
+}
+
+void TaskGraph::addTask (ProgressiveTask* taskToAdd, double weight)
+{
+	jassert (taskToAdd != nullptr && tasks.indexOfTask (taskToAdd) < 0);
+
+	tasks.addTask (taskToAdd, weight);
+	dependents.add (Array< int > ());
+}
+
+bool TaskGraph::addDependency (ProgressiveTask* task, ProgressiveTask* dependency)
+{
+	const int taskIndex = tasks.indexOfTask (task);
+	const int dependencyIndex = tasks.indexOfTask (dependency);
+
+	if (taskIndex < 0 || dependencyIndex < 0 || taskIndex == dependencyIndex)
+	{
+		jassertfalse;
+		return false;
+	}
+
+	dependents.getReference (dependencyIndex).addIfNotAlreadyThere (taskIndex);
+	return true;
+}
+
+const TaskSequence& TaskGraph::getTasks () const
+{
+	return tasks;
+}
+
+bool TaskGraph::shouldStopOnError () const
+{
+	return stopOnError;
+}
+
+bool TaskGraph::isAcyclic () const
+{
+	const int numTasks = tasks.size();
+
+	Array< int > numDependencies;
+	numDependencies.insertMultiple (0, 0, numTasks);
+
+	for (int i = 0; i < numTasks; ++i)
+	{
+		const Array< int >& taskDependents = dependents.getReference (i);
+
+		for (int j = 0; j < taskDependents.size(); ++j)
+			numDependencies.getReference (taskDependents.getUnchecked (j))++;
+	}
+
+	Array< int > ready;
+
+	for (int i = 0; i < numTasks; ++i)
+	{
+		if (numDependencies.getUnchecked (i) == 0)
+			ready.add (i);
+	}
+
+	// Any task that never becomes ready must be part of a cycle.
+	int numVisited = 0;
+
+	while (numVisited < ready.size())
+	{
+		const Array< int >& taskDependents = dependents.getReference (ready.getUnchecked (numVisited++));
+
+		for (int j = 0; j < taskDependents.size(); ++j)
+		{
+			const int dependent = taskDependents.getUnchecked (j);
+
+			if (--(numDependencies.getReference (dependent)) == 0)
+				ready.add (dependent);
+		}
+	}
+
+	return numVisited == numTasks;
+}
+
+Result TaskGraph::run ()
+{
+	if (! isAcyclic ())
+		return Result::fail ("Task graph contains a cycle");
+
+	return performSubTaskGraph (tasks, dependents, 1.0, stopOnError, pool);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+class TaskGraphTests	:	public UnitTest
+{
+public:
+
+	TaskGraphTests () : UnitTest ("TaskGraph") {}
+
+	virtual void runTest ()
+	{
+		TaskThreadPool pool (2);
+
+		beginTest ("Diamond graph runs in dependency order");
+		{
+			RunOrder order;
+			TaskGraph* graph = new TaskGraph ("Diamond", pool);
+
+			RecordingTask* a = new RecordingTask ("A", order);
+			RecordingTask* b = new RecordingTask ("B", order);
+			RecordingTask* c = new RecordingTask ("C", order);
+			RecordingTask* d = new RecordingTask ("D", order);
+
+			graph->addTask (a);
+			graph->addTask (b);
+			graph->addTask (c);
+			graph->addTask (d);
+			graph->addDependency (b, a);
+			graph->addDependency (c, a);
+			graph->addDependency (d, b);
+			graph->addDependency (d, c);
+
+			expect (graph->isAcyclic ());
+			expect (runGraph (graph).wasOk ());
+
+			const StringArray names (order.getNames ());
+
+			expectEquals (names.size (), 4);
+			expectEquals (names.indexOf ("A"), 0);
+			expectEquals (names.indexOf ("D"), 3);
+			expect (names.contains ("B") && names.contains ("C"));
+		}
+
+		beginTest ("Cycle is rejected");
+		{
+			RunOrder order;
+			TaskGraph* graph = new TaskGraph ("Cycle", pool);
+
+			RecordingTask* a = new RecordingTask ("A", order);
+			RecordingTask* b = new RecordingTask ("B", order);
+			RecordingTask* c = new RecordingTask ("C", order);
+
+			graph->addTask (a);
+			graph->addTask (b);
+			graph->addTask (c);
+			graph->addDependency (b, a);
+			graph->addDependency (c, b);
+			graph->addDependency (a, c);
+
+			expect (! graph->isAcyclic ());
+			expect (runGraph (graph).failed ());
+			expectEquals (order.getNames ().size (), 0);
+		}
+
+		beginTest ("Failed dependency skips its dependents");
+		{
+			RunOrder order;
+			TaskGraph* graph = new TaskGraph ("Failure", pool, false);
+
+			RecordingTask* a = new RecordingTask ("A", order, Result::fail ("A failed"));
+			RecordingTask* b = new RecordingTask ("B", order);
+			RecordingTask* c = new RecordingTask ("C", order);
+
+			graph->addTask (a);
+			graph->addTask (b);
+			graph->addTask (c);
+			graph->addDependency (b, a);
+
+			const Result result (runGraph (graph));
+			const StringArray names (order.getNames ());
+
+			expect (result.failed ());
+			expectEquals (result.getErrorMessage (), String ("A failed"));
+			expect (names.contains ("A"));
+			expect (! names.contains ("B"), "A task ran after its dependency failed");
+			expect (names.contains ("C"), "An independent task didn't run");
+		}
+	}
+
+private:
+
+	/** The names of the tasks, in the order they started running. */
+	class RunOrder
+	{
+	public:
+
+		void add (const String& name)
+		{
+			const ScopedLock sl (lock);
+			names.add (name);
+		}
+
+		StringArray getNames () const
+		{
+			const ScopedLock sl (lock);
+			return names;
+		}
+
+	private:
+
+		CriticalSection lock;
+		StringArray names;	// guarded by lock
+	};
+
+	class RecordingTask	:	public ProgressiveTask
+	{
+	public:
+
+		RecordingTask (const String& name, RunOrder& order_, const Result& result_ = Result::ok ())
+			:	ProgressiveTask (name),
+				order (order_),
+				result (result_)
+		{
+		}
+
+		virtual Result run () override
+		{
+			order.add (getName ());
+			return result;
+		}
+
+	private:
+
+		RunOrder& order;
+		const Result result;
+	};
+
+	static Result runGraph (TaskGraph* graph)
+	{
+		InlineTaskDispatcher dispatcher;
+
+		TaskContext::Ptr context (new TaskContext (graph));
+		context->setDispatcher (dispatcher);
+
+		InlineTaskRunner runner;
+		runner.runTask (context);
+
+		const Result result (context->getResult ());
+		context = nullptr;
+		return result;
+	}
+};
+
+static TaskGraphTests taskGraphTests;
+
+///////////////////////////////////////////////////////////////////////////////
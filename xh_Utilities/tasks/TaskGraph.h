@@ -0,0 +1,77 @@
+#ifndef TASKGRAPH_H_INCLUDED
+#define TASKGRAPH_H_INCLUDED
+
+///////////////////////////////////////////////////////////////////////////////
+/**
+	Helper task for running a set of tasks which depend on each other. Each
+	task is started as soon as all of the tasks it depends on have finished,
+	so independent branches of the graph run concurrently on a TaskThreadPool.
+
+	e.g.
+
+	TaskGraph* graph = new TaskGraph ("Render", pool);
+	graph->addTask (decode);
+	graph->addTask (analyse);
+	graph->addTask (renderA, 2.0);
+	graph->addTask (renderB, 2.0);
+	graph->addTask (package);
+	graph->addDependency (analyse, decode);
+	graph->addDependency (renderA, analyse);
+	graph->addDependency (renderB, analyse);
+	graph->addDependency (package, renderA);
+	graph->addDependency (package, renderB);
+
+	The overall progress is the weighted sum of the tasks' progress, using the
+	weights given when they were added.
+*/
+///////////////////////////////////////////////////////////////////////////////
+
+class TaskGraph	:	public ProgressiveTask
+{
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TaskGraph);
+public:
+
+	/** Create a new task graph.
+     
+        @param taskName             The name for this task.
+        @param poolToUse            The pool which will provide the extra threads
+                                    used to run independent tasks concurrently.
+                                    This must outlive the graph's execution.
+        @param stopOnSubTaskError   If true, no more tasks are started once one
+                                    has failed.
+     */
+	TaskGraph (const juce::String& taskName, TaskThreadPool& poolToUse, bool stopOnSubTaskError = true);
+	virtual ~TaskGraph ();
+
+	/** Adds a task to the graph, which takes ownership of it. */
+	void addTask (ProgressiveTask* taskToAdd, double weight = 1.0);
+
+	/** Declares that a task cannot start until another has finished. Both
+		tasks must already have been added to the graph.
+
+		@returns	false if either task is not part of the graph.
+	*/
+	bool addDependency (ProgressiveTask* task, ProgressiveTask* dependency);
+
+	const TaskSequence& getTasks () const;
+
+	bool shouldStopOnError () const;
+
+	/** Returns true if the dependencies don't contain any cycles (which would
+		prevent the graph from being run). */
+	bool isAcyclic () const;
+
+	juce::Result run () override;
+
+private:
+
+	TaskSequence tasks;
+	juce::Array< juce::Array< int > > dependents;
+	TaskThreadPool& pool;
+	bool stopOnError;
+
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif  // TASKGRAPH_H_INCLUDED
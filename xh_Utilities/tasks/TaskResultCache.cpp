@@ -0,0 +1,423 @@
+
+///////////////////////////////////////////////////////////////////////////////
+
+/** A cached result, kept in a list ordered from the most to the least
+	recently used. */
+class TaskResultCache::Entry
+{
+public:
+
+	Entry (const String& key_, const Result& result_, const var& payload_)
+		:	key (key_),
+			result (result_),
+			payload (payload_),
+			previous (nullptr),
+			next (nullptr)
+	{
+	}
+
+	const String key;
+	Result result;
+	var payload;
+	Entry* previous;
+	Entry* next;
+
+	JUCE_DECLARE_NON_COPYABLE (Entry);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+TaskResultCache::TaskResultCache (int maxEntriesInMemory, const File& directory)
+	:	newest (nullptr),
+		oldest (nullptr),
+		maxEntries (jmax (1, maxEntriesInMemory)),
+		numHits (0),
+		numDiskHits (0),
+		numMisses (0)
+{
+	setDiskDirectory (directory);
+}
+
+TaskResultCache::~TaskResultCache ()
+{
+	clear (false);
+}
+
+bool TaskResultCache::lookup (const String& key, Result& result, var& payload)
+{
+	File file;
+	{
+		ScopedLock sl (lock);
+
+		Entry* entry = findEntry (key);
+		if (entry != nullptr)
+		{
+			moveToFront (entry);
+			result = entry->result;
+			payload = entry->payload;
+			++numHits;
+			return true;
+		}
+
+		file = getFileForKey (key);
+	}
+
+	// The disk is read without the lock, so other lookups aren't held up.
+	if (file != File::nonexistent && readFromDisk (file, key, result, payload))
+	{
+		ScopedLock sl (lock);
+
+		if (findEntry (key) == nullptr)
+			addEntry (key, result, payload);
+
+		++numDiskHits;
+		return true;
+	}
+
+	ScopedLock sl (lock);
+	++numMisses;
+	return false;
+}
+
+void TaskResultCache::store (const String& key, const Result& result, const var& payload)
+{
+	if (key.isEmpty ())
+		return;
+
+	File file;
+	{
+		ScopedLock sl (lock);
+
+		Entry* entry = findEntry (key);
+		if (entry != nullptr)
+			removeEntry (entry);
+
+		addEntry (key, result, payload);
+		file = getFileForKey (key);
+	}
+
+	if (file != File::nonexistent)
+		writeToDisk (file, key, result, payload);
+}
+
+void TaskResultCache::remove (const String& key)
+{
+	File file;
+	{
+		ScopedLock sl (lock);
+
+		Entry* entry = findEntry (key);
+		if (entry != nullptr)
+			removeEntry (entry);
+
+		file = getFileForKey (key);
+	}
+
+	if (file != File::nonexistent)
+		file.deleteFile ();
+}
+
+void TaskResultCache::clear (bool alsoClearDisk)
+{
+	File directory;
+	{
+		ScopedLock sl (lock);
+
+		while (newest != nullptr)
+			removeEntry (newest);
+
+		directory = diskDirectory;
+	}
+
+	if (alsoClearDisk && directory.isDirectory ())
+	{
+		Array< File > files;
+		directory.findChildFiles (files, File::findFiles, false, "*.json");
+
+		for (int i = 0; i < files.size(); ++i)
+			files.getReference (i).deleteFile ();
+	}
+}
+
+void TaskResultCache::setMaxEntriesInMemory (int newMaxEntries)
+{
+	ScopedLock sl (lock);
+	maxEntries = jmax (1, newMaxEntries);
+	trim ();
+}
+
+void TaskResultCache::setDiskDirectory (const File& directory)
+{
+	if (directory != File::nonexistent)
+		directory.createDirectory ();
+
+	ScopedLock sl (lock);
+	diskDirectory = directory;
+}
+
+int TaskResultCache::getNumEntriesInMemory () const
+{
+	ScopedLock sl (lock);
+	return entries.size();
+}
+
+int64 TaskResultCache::getNumHits () const
+{
+	ScopedLock sl (lock);
+	return numHits;
+}
+
+int64 TaskResultCache::getNumDiskHits () const
+{
+	ScopedLock sl (lock);
+	return numDiskHits;
+}
+
+int64 TaskResultCache::getNumMisses () const
+{
+	ScopedLock sl (lock);
+	return numMisses;
+}
+
+void TaskResultCache::resetStatistics ()
+{
+	ScopedLock sl (lock);
+	numHits = numDiskHits = numMisses = 0;
+}
+
+TaskResultCache::Entry* TaskResultCache::findEntry (const String& key) const
+{
+	return entries [key];
+}
+
+void TaskResultCache::addEntry (const String& key, const Result& result, const var& payload)
+{
+	Entry* entry = new Entry (key, result, payload);
+	entries.set (key, entry);
+
+	entry->next = newest;
+	if (newest != nullptr)
+		newest->previous = entry;
+	newest = entry;
+
+	if (oldest == nullptr)
+		oldest = entry;
+
+	trim ();
+}
+
+void TaskResultCache::removeEntry (Entry* entry)
+{
+	if (entry->previous != nullptr)
+		entry->previous->next = entry->next;
+	else
+		newest = entry->next;
+
+	if (entry->next != nullptr)
+		entry->next->previous = entry->previous;
+	else
+		oldest = entry->previous;
+
+	entries.remove (entry->key);
+	delete entry;
+}
+
+void TaskResultCache::moveToFront (Entry* entry)
+{
+	if (entry == newest)
+		return;
+
+	// Unlink...
+	entry->previous->next = entry->next;
+
+	if (entry->next != nullptr)
+		entry->next->previous = entry->previous;
+	else
+		oldest = entry->previous;
+
+	// ...and put it back at the front.
+	entry->previous = nullptr;
+	entry->next = newest;
+	newest->previous = entry;
+	newest = entry;
+}
+
+void TaskResultCache::trim ()
+{
+	// Anything discarded here is still on disk, if there's a disk tier.
+	while (entries.size() > maxEntries && oldest != nullptr)
+		removeEntry (oldest);
+}
+
+File TaskResultCache::getFileForKey (const String& key) const
+{
+	if (diskDirectory == File::nonexistent)
+		return File::nonexistent;
+
+	return diskDirectory.getChildFile (String::toHexString (key.hashCode64 ()) + ".json");
+}
+
+bool TaskResultCache::readFromDisk (const File& file, const String& key, Result& result, var& payload) const
+{
+	if (! file.existsAsFile ())
+		return false;
+
+	const var entry (JSON::parse (file));
+
+	// Different keys could share a file name, so the key is checked too.
+	if (entry ["key"].toString () != key)
+		return false;
+
+	const String error (entry ["error"].toString ());
+	result = error.isEmpty () ? Result::ok () : Result::fail (error);
+	payload = entry ["payload"];
+	return true;
+}
+
+void TaskResultCache::writeToDisk (const File& file, const String& key, const Result& result, const var& payload) const
+{
+	DynamicObject::Ptr entry (new DynamicObject ());
+	entry->setProperty ("key", key);
+	entry->setProperty ("error", result.getErrorMessage ());
+	entry->setProperty ("payload", payload);
+
+	file.replaceWithText (JSON::toString (var (entry), true));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+class TaskResultCacheTests	:	public UnitTest
+{
+public:
+
+	TaskResultCacheTests () : UnitTest ("TaskResultCache") {}
+
+	virtual void runTest ()
+	{
+		beginTest ("Least recently used entries are discarded");
+		{
+			TaskResultCache cache (3);
+
+			cache.store ("a", Result::ok (), 1);
+			cache.store ("b", Result::ok (), 2);
+			cache.store ("c", Result::ok (), 3);
+
+			// Using "a" makes "b" the oldest...
+			expect (isInMemory (cache, "a"));
+
+			cache.store ("d", Result::ok (), 4);
+
+			expectEquals (cache.getNumEntriesInMemory (), 3);
+			expect (! isInMemory (cache, "b"));
+			expect (isInMemory (cache, "a"));
+			expect (isInMemory (cache, "c"));
+			expect (isInMemory (cache, "d"));
+
+			// ...and shrinking keeps the most recently used.
+			cache.setMaxEntriesInMemory (1);
+
+			expectEquals (cache.getNumEntriesInMemory (), 1);
+			expect (isInMemory (cache, "d"));
+		}
+
+		beginTest ("Hit and miss counts");
+		{
+			TaskResultCache cache (2);
+			Result result (Result::ok ());
+			var payload;
+
+			cache.store ("a", Result::fail ("Stored error"), 42);
+
+			expect (cache.lookup ("a", result, payload));
+			expectEquals (result.getErrorMessage (), String ("Stored error"));
+			expect (payload == var (42));
+
+			expect (! cache.lookup ("missing", result, payload));
+			expect (! cache.lookup ("missing", result, payload));
+
+			expectEquals (cache.getNumHits (), (int64) 1);
+			expectEquals (cache.getNumDiskHits (), (int64) 0);
+			expectEquals (cache.getNumMisses (), (int64) 2);
+
+			cache.resetStatistics ();
+
+			expectEquals (cache.getNumHits (), (int64) 0);
+			expectEquals (cache.getNumMisses (), (int64) 0);
+		}
+
+		const File directory (File::getSpecialLocation (File::tempDirectory)
+								.getNonexistentChildFile ("TaskResultCacheTests", String::empty, false));
+
+		beginTest ("Entries are found on disk");
+		{
+			TaskResultCache cache (1, directory);
+			Result result (Result::ok ());
+			var payload;
+
+			cache.store ("a", Result::ok (), "first");
+			cache.store ("b", Result::ok (), "second");
+
+			expectEquals (cache.getNumEntriesInMemory (), 1);
+
+			expect (cache.lookup ("a", result, payload));
+			expectEquals (payload.toString (), String ("first"));
+			expectEquals (cache.getNumDiskHits (), (int64) 1);
+			expectEquals (cache.getNumHits (), (int64) 0);
+
+			cache.clear (true);
+		}
+
+		beginTest ("Colliding keys on disk aren't mixed up");
+		{
+			TaskResultCache cache (1, directory);
+			Result result (Result::ok ());
+			var payload;
+
+			cache.store ("a", Result::ok (), "first");
+			cache.clear (false);
+
+			// Make the file look like it belongs to a different key which
+			// happens to have the same hash.
+			Array< File > files;
+			directory.findChildFiles (files, File::findFiles, false, "*.json");
+			expectEquals (files.size (), 1);
+
+			if (files.size () == 1)
+			{
+				DynamicObject::Ptr entry (new DynamicObject ());
+				entry->setProperty ("key", "not a");
+				entry->setProperty ("error", String::empty);
+				entry->setProperty ("payload", "other");
+
+				files.getReference (0).replaceWithText (JSON::toString (var (entry), true));
+			}
+
+			expect (! cache.lookup ("a", result, payload), "Found an entry stored under a different key");
+			expectEquals (cache.getNumDiskHits (), (int64) 0);
+			expectEquals (cache.getNumMisses (), (int64) 1);
+
+			cache.clear (true);
+		}
+
+		directory.deleteRecursively ();
+	}
+
+private:
+
+	/** Returns true if the key is in the memory tier (which also makes it
+		the most recently used entry). */
+	static bool isInMemory (TaskResultCache& cache, const String& key)
+	{
+		const int64 hitsBefore = cache.getNumHits ();
+
+		Result result (Result::ok ());
+		var payload;
+		cache.lookup (key, result, payload);
+
+		return cache.getNumHits () > hitsBefore;
+	}
+};
+
+static TaskResultCacheTests taskResultCacheTests;
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,100 @@
+#ifndef TASKRESULTCACHE_H_INCLUDED
+#define TASKRESULTCACHE_H_INCLUDED
+
+///////////////////////////////////////////////////////////////////////////////
+/**
+	Remembers the results of deterministic tasks, so that running the same
+	task again (with the same inputs) can return straight away.
+
+	A task opts in by returning a key from ProgressiveTask::getCacheKey()
+	which identifies its inputs (e.g. a file's path and modification time).
+	Along with the Result, the cache keeps a payload from the task's
+	getCachePayload(), which is handed back to restoreFromCachePayload() on a
+	hit. Only successful, un-aborted results are stored.
+
+	The cache keeps a bounded number of entries in memory, discarding the
+	least recently used ones. If it's given a directory, every entry is also
+	written there as a JSON file, and entries which aren't in memory are
+	looked for there (in which case the payload must be something JSON can
+	represent).
+
+	Give a cache to a TaskThreadPool (or an individual TaskContext) with
+	setResultCache(). It's safe to use from any number of threads.
+*/
+///////////////////////////////////////////////////////////////////////////////
+
+class TaskResultCache
+{
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TaskResultCache);
+public:
+
+	TaskResultCache (int maxEntriesInMemory = 256, const juce::File& diskDirectory = juce::File::nonexistent);
+	~TaskResultCache ();
+
+	/** Looks for an entry, first in memory and then on disk.
+
+		@returns	true (setting result and payload) if the entry was found.
+	*/
+	bool lookup (const juce::String& key, juce::Result& result, juce::var& payload);
+
+	/** Adds (or replaces) an entry. */
+	void store (const juce::String& key, const juce::Result& result, const juce::var& payload);
+
+	/** Removes an entry, from both memory and disk. */
+	void remove (const juce::String& key);
+
+	/** Removes all of the entries from memory, and optionally from disk. */
+	void clear (bool alsoClearDisk);
+
+	/** Sets the number of entries kept in memory. */
+	void setMaxEntriesInMemory (int maxEntries);
+
+	/** Sets the directory used for the on-disk tier. If this is
+		File::nonexistent, only the memory tier is used. */
+	void setDiskDirectory (const juce::File& directory);
+
+	/** Returns the number of entries currently held in memory. */
+	int getNumEntriesInMemory () const;
+
+	/** Returns the number of lookups found in memory. */
+	juce::int64 getNumHits () const;
+
+	/** Returns the number of lookups which weren't in memory, but were found
+		on disk. */
+	juce::int64 getNumDiskHits () const;
+
+	/** Returns the number of lookups which weren't found at all. */
+	juce::int64 getNumMisses () const;
+
+	/** Sets all of the hit and miss counts back to zero. */
+	void resetStatistics ();
+
+private:
+
+	class Entry;
+
+	Entry* findEntry (const juce::String& key) const;
+	void addEntry (const juce::String& key, const juce::Result& result, const juce::var& payload);
+	void removeEntry (Entry* entry);
+	void moveToFront (Entry* entry);
+	void trim ();
+
+	juce::File getFileForKey (const juce::String& key) const;
+	bool readFromDisk (const juce::File& file, const juce::String& key, juce::Result& result, juce::var& payload) const;
+	void writeToDisk (const juce::File& file, const juce::String& key, const juce::Result& result, const juce::var& payload) const;
+
+	juce::CriticalSection lock;
+	juce::HashMap< juce::String, Entry* > entries;	// guarded by lock
+	Entry* newest;	// guarded by lock
+	Entry* oldest;	// guarded by lock
+	int maxEntries;
+	juce::File diskDirectory;	// guarded by lock
+
+	juce::int64 numHits;
+	juce::int64 numDiskHits;
+	juce::int64 numMisses;	// all guarded by lock
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif  // TASKRESULTCACHE_H_INCLUDED
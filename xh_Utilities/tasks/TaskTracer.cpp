@@ -0,0 +1,201 @@
+
+///////////////////////////////////////////////////////////////////////////////
+
+Atomic< TaskTracer* > TaskTracer::activeTracer;
+Atomic< int > TaskTracer::numEventsBeingAdded;
+
+TaskTracer::TaskTracer ()
+	:	startTicks (Time::getHighResolutionTicks ())
+{
+}
+
+TaskTracer::~TaskTracer ()
+{
+	stop ();
+}
+
+void TaskTracer::start ()
+{
+	TaskTracer* const previous = activeTracer.exchange (this);
+
+	// The previous tracer may be deleted as soon as it's been replaced.
+	if (previous != nullptr && previous != this)
+		waitForEventsToBeAdded ();
+}
+
+void TaskTracer::stop ()
+{
+	// Once this returns, no other thread can be part way through adding an
+	// event to this tracer.
+	if (activeTracer.compareAndSetBool (nullptr, this))
+		waitForEventsToBeAdded ();
+}
+
+bool TaskTracer::isActive () const
+{
+	return activeTracer.get() == this;
+}
+
+void TaskTracer::clear ()
+{
+	ScopedLock sl (lock);
+
+	for (int i = 0; i < buffers.size(); ++i)
+	{
+		ThreadBuffer& buffer = *buffers.getUnchecked (i);
+
+		const SpinLock::ScopedLockType bsl (buffer.lock);
+		buffer.events.clearQuick ();
+	}
+}
+
+int TaskTracer::getNumEvents () const
+{
+	ScopedLock sl (lock);
+
+	int numEvents = 0;
+
+	for (int i = 0; i < buffers.size(); ++i)
+	{
+		ThreadBuffer& buffer = *buffers.getUnchecked (i);
+
+		const SpinLock::ScopedLockType bsl (buffer.lock);
+		numEvents += buffer.events.size();
+	}
+
+	return numEvents;
+}
+
+String TaskTracer::toJSON () const
+{
+	ScopedLock sl (lock);
+
+	String json;
+	json.preallocateBytes ((size_t) (getNumEvents () + buffers.size()) * 96);
+	json << "{\"traceEvents\":[";
+
+	// Name each thread, so the timeline viewer can label its track.
+	for (int i = 0; i < buffers.size(); ++i)
+	{
+		json << (i > 0 ? "," : "") << newLine
+			 << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << i
+			 << ",\"args\":{\"name\":" << JSON::toString (buffers.getUnchecked (i)->threadName) << "}}";
+	}
+
+	// Each thread's events are already in order, and the viewer sorts the
+	// threads' timelines against each other by their timestamps.
+	for (int i = 0; i < buffers.size(); ++i)
+	{
+		ThreadBuffer& buffer = *buffers.getUnchecked (i);
+		const SpinLock::ScopedLockType bsl (buffer.lock);
+
+		for (int j = 0; j < buffer.events.size(); ++j)
+		{
+			const Event& event = buffer.events.getReference (j);
+
+			json << "," << newLine
+				 << "{\"name\":" << JSON::toString (event.name)
+				 << ",\"cat\":\"" << event.category
+				 << "\",\"ph\":\"" << String::charToString ((juce_wchar) event.phase)
+				 << "\",\"ts\":" << event.timeMicroseconds
+				 << ",\"pid\":1,\"tid\":" << i;
+
+			if (event.phase == 'i')
+				json << ",\"s\":\"t\"";
+
+			json << "}";
+		}
+	}
+
+	json << newLine << "],\"displayTimeUnit\":\"ms\"}" << newLine;
+	return json;
+}
+
+Result TaskTracer::writeToFile (const File& file) const
+{
+	if (! file.replaceWithText (toJSON ()))
+		return Result::fail ("Couldn't write trace to " + file.getFullPathName ());
+
+	return Result::ok ();
+}
+
+bool TaskTracer::isAnyTracerActive ()
+{
+	return activeTracer.value != nullptr;
+}
+
+void TaskTracer::taskBegan (const ProgressiveTask& task)
+{
+	if (isAnyTracerActive ())
+		addEventToActiveTracer (task.getName (), "task", 'B');
+}
+
+void TaskTracer::taskEnded (const ProgressiveTask& task)
+{
+	if (isAnyTracerActive ())
+		addEventToActiveTracer (task.getName (), "task", 'E');
+}
+
+void TaskTracer::contextStateChanged (TaskContext& context)
+{
+	if (isAnyTracerActive ())
+		addEventToActiveTracer (context.getTask().getName () + ": " + context.getStateDescription (), "state", 'i');
+}
+
+void TaskTracer::addEventToActiveTracer (const String& name, const char* category, char phase)
+{
+	// While the count is raised, the tracer can't be stopped or replaced
+	// out from under us (see waitForEventsToBeAdded()).
+	++numEventsBeingAdded;
+
+	TaskTracer* tracer = activeTracer.get();
+	if (tracer != nullptr)
+		tracer->addEvent (name, category, phase);
+
+	--numEventsBeingAdded;
+}
+
+void TaskTracer::waitForEventsToBeAdded ()
+{
+	// The active tracer has just been changed, so any thread which raises the
+	// count from now on will see the new one; we only have to wait for the
+	// threads which might still be adding to the old one.
+	while (numEventsBeingAdded.get() != 0)
+		Thread::yield ();
+}
+
+void TaskTracer::addEvent (const String& name, const char* category, char phase)
+{
+	const int64 ticks = Time::getHighResolutionTicks ();
+
+	Event event;
+	event.name = name;
+	event.category = category;
+	event.phase = phase;
+	event.timeMicroseconds = (int64) (Time::highResolutionTicksToSeconds (ticks - startTicks) * 1.0e6);
+
+	ThreadBuffer& buffer = getBufferForCurrentThread ();
+
+	const SpinLock::ScopedLockType sl (buffer.lock);
+	buffer.events.add (event);
+}
+
+TaskTracer::ThreadBuffer& TaskTracer::getBufferForCurrentThread ()
+{
+	ThreadBuffer*& buffer = currentThreadBuffer.get ();
+
+	// The tracer's lock is only needed the first time each thread adds an event.
+	if (buffer == nullptr)
+	{
+		ScopedLock sl (lock);
+
+		Thread* thread = Thread::getCurrentThread ();
+
+		buffer = buffers.add (new ThreadBuffer ());
+		buffer->threadName = thread != nullptr ? thread->getThreadName () : String ("Thread ") + String (buffers.size());
+	}
+
+	return *buffer;
+}
+
+///////////////////////////////////////////////////////////////////////////////
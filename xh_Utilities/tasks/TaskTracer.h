@@ -0,0 +1,103 @@
+#ifndef TASKTRACER_H_INCLUDED
+#define TASKTRACER_H_INCLUDED
+
+///////////////////////////////////////////////////////////////////////////////
+/**
+	Records a timeline of task execution, which can be saved in the Chrome
+	trace event format and opened in chrome://tracing or Perfetto.
+
+	While a tracer is active, every ExecutionScope records a begin event when
+	it is created and an end event when it is destroyed (so sub-tasks appear
+	nested within their parents), on the thread it ran on. TaskContext state
+	changes are recorded as instant events.
+
+	e.g.
+
+	TaskTracer tracer;
+	tracer.start ();
+	... run some tasks ...
+	tracer.stop ();
+	tracer.writeToFile (File::getSpecialLocation (File::userDesktopDirectory).getChildFile ("trace.json"));
+
+	Only one tracer can be active at a time. When no tracer is active, the
+	cost to the task classes is a single check of a pointer. Each thread
+	records into its own buffer, so worker threads don't contend with each
+	other while tracing; the buffers are merged when the trace is written.
+*/
+///////////////////////////////////////////////////////////////////////////////
+
+class TaskTracer
+{
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TaskTracer);
+public:
+
+	TaskTracer ();
+	~TaskTracer ();
+
+	/** Makes this the active tracer, replacing any other. */
+	void start ();
+
+	/** Stops recording events, if this is the active tracer. */
+	void stop ();
+
+	/** Returns true if this is the active tracer. */
+	bool isActive () const;
+
+	/** Discards all of the events recorded so far. */
+	void clear ();
+
+	/** Returns the number of events recorded so far. */
+	int getNumEvents () const;
+
+	/** Returns the recorded events as a Chrome trace event JSON document. */
+	juce::String toJSON () const;
+
+	/** Writes the recorded events to a Chrome trace event JSON file. */
+	juce::Result writeToFile (const juce::File& file) const;
+
+	///////////////////////////////////////////////////////////////////////////
+
+	/** These are called by the task classes to record events with the active
+		tracer (if there is one). */
+	static void taskBegan (const ProgressiveTask& task);
+	static void taskEnded (const ProgressiveTask& task);
+	static void contextStateChanged (TaskContext& context);
+
+private:
+
+	struct Event
+	{
+		juce::String name;
+		const char* category;
+		char phase;
+		juce::int64 timeMicroseconds;
+	};
+
+	/** The events recorded on one thread. Only that thread adds to it, so its
+		lock is only ever contended while the events are being read. */
+	struct ThreadBuffer
+	{
+		juce::String threadName;
+		juce::SpinLock lock;
+		juce::Array< Event > events;	// guarded by lock
+	};
+
+	static bool isAnyTracerActive ();
+	static void addEventToActiveTracer (const juce::String& name, const char* category, char phase);
+	static void waitForEventsToBeAdded ();
+	void addEvent (const juce::String& name, const char* category, char phase);
+	ThreadBuffer& getBufferForCurrentThread ();
+
+	juce::CriticalSection lock;
+	juce::OwnedArray< ThreadBuffer > buffers;	// guarded by lock
+	juce::ThreadLocalValue< ThreadBuffer* > currentThreadBuffer;
+	juce::int64 startTicks;
+
+	static juce::Atomic< TaskTracer* > activeTracer;
+	static juce::Atomic< int > numEventsBeingAdded;
+
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif//TASKTRACER_H_INCLUDED
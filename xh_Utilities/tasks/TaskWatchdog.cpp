@@ -0,0 +1,324 @@
+
+///////////////////////////////////////////////////////////////////////////////
+
+TaskWatchdog::Timeout::Timeout ()
+	:	owner (nullptr),
+		previous (nullptr),
+		next (nullptr),
+		slot (0),
+		rounds (0)
+{
+}
+
+TaskWatchdog::Timeout::~Timeout ()
+{
+	// A timeout must be cancelled before it's deleted!
+	jassert (owner == nullptr);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+TaskWatchdog::TaskWatchdog (int tickMilliseconds, int numSlots_)
+	:	Thread ("TaskWatchdog"),
+		slots ((size_t) jmax (1, numSlots_), true),
+		tickMs (jmax (1, tickMilliseconds)),
+		numSlots (jmax (1, numSlots_)),
+		processedTick (0),
+		numScheduled (0)
+{
+}
+
+TaskWatchdog::~TaskWatchdog ()
+{
+	stopThread (5000);
+}
+
+TaskWatchdog& TaskWatchdog::getInstance ()
+{
+	static TaskWatchdog instance;
+	return instance;
+}
+
+void TaskWatchdog::schedule (Timeout& timeout, int milliseconds)
+{
+	ScopedLock sl (lock);
+
+	jassert (timeout.owner == nullptr || timeout.owner == this);
+
+	if (timeout.owner == this)
+		unlink (timeout);
+
+	const int64 now = getCurrentTick ();
+
+	// There's nothing to catch up on if the wheel has been idle.
+	if (numScheduled == 0)
+		processedTick = now;
+
+	link (timeout, now + jmax (1, (milliseconds + tickMs - 1) / tickMs));
+
+	if (! isThreadRunning ())
+		startThread ();
+
+	notify ();
+}
+
+bool TaskWatchdog::cancel (Timeout& timeout)
+{
+	ScopedLock sl (lock);
+
+	if (timeout.owner != this)
+		return false;
+
+	unlink (timeout);
+	return true;
+}
+
+int TaskWatchdog::getNumScheduled () const
+{
+	ScopedLock sl (lock);
+	return numScheduled;
+}
+
+void TaskWatchdog::run ()
+{
+	while (! threadShouldExit ())
+	{
+		int timeOut = -1;
+
+		{
+			ScopedLock sl (lock);
+			const int64 now = getCurrentTick ();
+
+			while (processedTick < now && numScheduled > 0)
+				expireTick (++processedTick);
+
+			if (numScheduled > 0)
+				timeOut = tickMs;
+			else
+				processedTick = now;
+		}
+
+		wait (timeOut);
+	}
+}
+
+int64 TaskWatchdog::getCurrentTick () const
+{
+	return (int64) Time::getMillisecondCounterHiRes () / tickMs;
+}
+
+void TaskWatchdog::expireTick (int64 tick)
+{
+	Timeout* timeout = slots [(int) (tick % numSlots)];
+
+	while (timeout != nullptr)
+	{
+		// Timeouts mustn't touch the wheel when they fire, so this stays valid.
+		Timeout* const next = timeout->next;
+
+		if (timeout->rounds > 0)
+		{
+			--(timeout->rounds);
+		}
+		else
+		{
+			unlink (*timeout);
+			timeout->timeoutExpired ();
+		}
+
+		timeout = next;
+	}
+}
+
+void TaskWatchdog::link (Timeout& timeout, int64 tick)
+{
+	// The slots are visited in turn, starting with the tick after the last
+	// one processed; the timeout fires on its slot's (rounds + 1)th visit.
+	tick = jmax (tick, processedTick + 1);
+
+	timeout.owner = this;
+	timeout.slot = (int) (tick % numSlots);
+	timeout.rounds = (int) ((tick - processedTick - 1) / numSlots);
+
+	timeout.previous = nullptr;
+	timeout.next = slots [timeout.slot];
+
+	if (timeout.next != nullptr)
+		timeout.next->previous = &timeout;
+
+	slots [timeout.slot] = &timeout;
+	++numScheduled;
+}
+
+void TaskWatchdog::unlink (Timeout& timeout)
+{
+	if (timeout.previous != nullptr)
+		timeout.previous->next = timeout.next;
+	else
+		slots [timeout.slot] = timeout.next;
+
+	if (timeout.next != nullptr)
+		timeout.next->previous = timeout.previous;
+
+	timeout.owner = nullptr;
+	timeout.previous = nullptr;
+	timeout.next = nullptr;
+	--numScheduled;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+class TaskWatchdogTests	:	public UnitTest
+{
+public:
+
+	TaskWatchdogTests () : UnitTest ("TaskWatchdog") {}
+
+	virtual void runTest ()
+	{
+		beginTest ("Timeouts longer than a turn of the wheel");
+		{
+			// With only 4 slots of 1ms, these have to go round several times.
+			TaskWatchdog watchdog (1, 4);
+			TestTimeout shortTimeout, longTimeout;
+
+			const double start = Time::getMillisecondCounterHiRes ();
+
+			watchdog.schedule (longTimeout, 30);
+			watchdog.schedule (shortTimeout, 2);
+			expectEquals (watchdog.getNumScheduled (), 2);
+
+			expect (shortTimeout.fired.wait (5000), "Short timeout didn't fire");
+			expect (longTimeout.fired.wait (5000), "Long timeout didn't fire");
+
+			expect (shortTimeout.timeFired < longTimeout.timeFired);
+			expect (longTimeout.timeFired - start >= 29.0,
+					"Long timeout fired after only " + String (longTimeout.timeFired - start, 1) + " ms");
+			expectEquals (watchdog.getNumScheduled (), 0);
+		}
+
+		beginTest ("Cancelling before expiry");
+		{
+			TaskWatchdog watchdog (1, 4);
+			TestTimeout timeout;
+
+			watchdog.schedule (timeout, 20);
+
+			expect (watchdog.cancel (timeout));
+			expect (! watchdog.cancel (timeout));
+			expectEquals (watchdog.getNumScheduled (), 0);
+
+			expect (! timeout.fired.wait (100), "A cancelled timeout fired");
+		}
+
+		beginTest ("Cancelling during expiry");
+		{
+			TaskWatchdog watchdog (1, 4);
+			TestTimeout timeout (50);
+
+			watchdog.schedule (timeout, 1);
+			expect (timeout.started.wait (5000), "Timeout didn't fire");
+
+			// This has to wait for the timeout to finish firing.
+			expect (! watchdog.cancel (timeout));
+			expect (timeout.finished.get () != 0, "Cancel returned while the timeout was still firing");
+		}
+
+		beginTest ("Timed out and aborted tasks");
+		{
+			InlineTaskDispatcher dispatcher;
+			InlineTaskRunner runner;
+			{
+				TaskContext::Ptr context (new TaskContext (new WaitingTask (-1)));
+				context->setDispatcher (dispatcher);
+				context->setTimeout (20);
+
+				runner.runTask (context);
+
+				expect (context->getState () == TaskContext::taskTimedOut);
+				expect (context->hasTimedOut ());
+				expect (context->wasAborted ());
+			}
+			{
+				TaskContext::Ptr context (new TaskContext (new WaitingTask (10)));
+				context->setDispatcher (dispatcher);
+				context->setTimeout (5000);
+
+				runner.runTask (context);
+
+				expect (context->getState () == TaskContext::taskAborted);
+				expect (! context->hasTimedOut ());
+				expect (context->wasAborted ());
+			}
+		}
+	}
+
+private:
+
+	class TestTimeout	:	public TaskWatchdog::Timeout
+	{
+	public:
+
+		TestTimeout (int busyMs_ = 0)
+			:	busyMs (busyMs_),
+				timeFired (0.0)
+		{
+		}
+
+		virtual void timeoutExpired () override
+		{
+			timeFired = Time::getMillisecondCounterHiRes ();
+			started.signal ();
+
+			if (busyMs > 0)
+				Thread::sleep (busyMs);
+
+			finished.set (1);
+			fired.signal ();
+		}
+
+		const int busyMs;
+		double timeFired;
+		WaitableEvent started, fired;
+		Atomic< int > finished;
+	};
+
+	/** Runs until it's aborted, optionally aborting itself after a while. */
+	class WaitingTask	:	public ProgressiveTask
+	{
+	public:
+
+		WaitingTask (int abortAfterMs_)
+			:	ProgressiveTask ("Waiting task"),
+				abortAfterMs (abortAfterMs_)
+		{
+		}
+
+		virtual Result run () override
+		{
+			const uint32 start = Time::getMillisecondCounter ();
+
+			while (! shouldAbort ())
+			{
+				const uint32 elapsed = Time::getMillisecondCounter () - start;
+
+				if (abortAfterMs >= 0 && elapsed >= (uint32) abortAfterMs)
+					abort ();
+				else if (elapsed > 5000)
+					return Result::fail ("The task was never aborted");
+
+				Thread::sleep (1);
+			}
+
+			return Result::ok ();
+		}
+
+	private:
+
+		const int abortAfterMs;
+	};
+};
+
+static TaskWatchdogTests taskWatchdogTests;
+
+///////////////////////////////////////////////////////////////////////////////
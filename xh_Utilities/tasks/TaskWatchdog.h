@@ -0,0 +1,107 @@
+#ifndef TASKWATCHDOG_H_INCLUDED
+#define TASKWATCHDOG_H_INCLUDED
+
+///////////////////////////////////////////////////////////////////////////////
+/**
+	A single thread which fires timeouts, used to enforce TaskContext
+	deadlines (see TaskContext::setDeadline()).
+
+	Timeouts are kept in a hashed timer wheel: a ring of slots, one per tick,
+	with each timeout linked into the slot its expiry time falls in (and a
+	count of how many more times round the ring it has to wait). Scheduling
+	and cancelling a timeout are constant time, however many are pending,
+	and the thread only looks at a single slot each tick. The price is that
+	timeouts only fire to the nearest tick.
+
+	The thread is only started when the first timeout is scheduled, and it
+	sleeps whenever there's nothing pending.
+*/
+///////////////////////////////////////////////////////////////////////////////
+
+class TaskWatchdog	:	private juce::Thread
+{
+public:
+
+	///////////////////////////////////////////////////////////////////////////
+
+	/** Something to be done when a timeout expires. A Timeout can only be
+		scheduled with one watchdog at a time, and must be cancelled before
+		it's deleted. */
+	class Timeout
+	{
+	public:
+
+		Timeout ();
+		virtual ~Timeout ();
+
+		/** Called on the watchdog's thread once the timeout has expired. The
+			watchdog is locked during the call, so this should be quick, and
+			mustn't schedule or cancel any timeouts itself. */
+		virtual void timeoutExpired () = 0;
+
+	private:
+
+		friend class TaskWatchdog;
+
+		TaskWatchdog* owner;	// guarded by the owner's lock
+		Timeout* previous;
+		Timeout* next;
+		int slot;
+		int rounds;
+
+		JUCE_DECLARE_NON_COPYABLE (Timeout);
+	};
+
+	///////////////////////////////////////////////////////////////////////////
+
+	/** Creates a watchdog.
+
+		@param	tickMilliseconds	The resolution of the timeouts.
+		@param	numSlots			The number of ticks in one turn of the
+									wheel. Timeouts longer than this are
+									still fine, but are looked at once on
+									each turn.
+	*/
+	TaskWatchdog (int tickMilliseconds = 10, int numSlots = 512);
+	~TaskWatchdog ();
+
+	/** Returns the watchdog shared by all TaskContexts. */
+	static TaskWatchdog& getInstance ();
+
+	/** Schedules a timeout to expire after the given number of milliseconds.
+		If it's already scheduled, it's rescheduled. This can be called from
+		any thread. */
+	void schedule (Timeout& timeout, int milliseconds);
+
+	/** Cancels a timeout, if it's scheduled. Once this has returned, the
+		timeout won't fire (and isn't firing).
+
+		@returns	true if the timeout was still pending.
+	*/
+	bool cancel (Timeout& timeout);
+
+	/** Returns the number of timeouts which are waiting to expire. */
+	int getNumScheduled () const;
+
+private:
+
+	virtual void run () override;
+
+	juce::int64 getCurrentTick () const;
+	void expireTick (juce::int64 tick);
+	void link (Timeout& timeout, juce::int64 tick);
+	void unlink (Timeout& timeout);
+
+	juce::CriticalSection lock;
+	juce::HeapBlock< Timeout* > slots;	// guarded by lock
+	const int tickMs;
+	const int numSlots;
+	juce::int64 processedTick;			// guarded by lock
+	int numScheduled;					// guarded by lock
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TaskWatchdog);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif//TASKWATCHDOG_H_INCLUDED
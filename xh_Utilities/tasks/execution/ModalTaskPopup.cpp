@@ -4,12 +4,14 @@
 ModalTaskPopup::ModalTaskPopup (ProgressiveTask* task)
 	:	progress (0.0)
 {
+	setNotificationPolicy (TaskContext::NotificationPolicy (30.0, 0.001));
 	setTaskContext (new TaskContext (task));
 }
 
 ModalTaskPopup::ModalTaskPopup (TaskContext* task)
 	:	progress (0.0)
 {
+	setNotificationPolicy (TaskContext::NotificationPolicy (30.0, 0.001));
 	setTaskContext (task);
 }
 
@@ -49,7 +51,7 @@ void ModalTaskPopup::taskStatusMessageChanged (TaskContext& )
 
 void ModalTaskPopup::taskProgressChanged (TaskContext& context)
 {
-	progress = context.getTask().getProgress();
+	progress = context.getOverallProgress();
 }
 
 void ModalTaskPopup::taskStart ()
@@ -84,7 +86,7 @@ bool ModalTaskPopup::monitor (bool stillRunning)
 {
 	if (stillRunning && alertWindow->isCurrentlyModal())
 	{
-		alertWindow->setMessage (getTaskContext()->getTask().getStatusMessage());
+		alertWindow->setMessage (getTaskContext()->getOverallStatusMessage());
 		return true;
 	}
 	return false;
@@ -22,7 +22,7 @@ void TaskContextViewComponent::paint (Graphics& g)
 	{
 
 		String name = handler->getTask().getName();
-		String msg = handler->getTask().getStatusMessage();
+		String msg = handler->getOverallStatusMessage();
 
 		// 		if (rowIsSelected)
 		// 		{
@@ -48,7 +48,7 @@ void TaskContextViewComponent::paint (Graphics& g)
 			break;
 		case TaskContext::taskRunning:
 			{
-				double prog = handler->getTask().getProgress();//getOverallProgress();
+				double prog = handler->getOverallProgress();
 				g.setColour (Colours::hotpink.withAlpha(0.5f));
 				g.fillRect (area.reduced(2).withTrimmedRight (roundDoubleToInt (area.getWidth() * (1 - prog))));
 			}
@@ -62,6 +62,7 @@ void TaskContextViewComponent::paint (Graphics& g)
 			break;
 
 		case TaskContext::taskAborted:
+		case TaskContext::taskTimedOut:
 			{
 				g.setColour (Colours::red.withAlpha(0.5f));
 				g.fillRect (area.reduced(2));
@@ -88,6 +89,9 @@ void TaskContextViewComponent::paint (Graphics& g)
 
 TaskContextListBoxModel::ItemComponent::ItemComponent (TaskContext* handler)
 {
+	// The progress bar repaints itself on a timer, so there's no point in
+	// hearing about progress any more often than it can show it.
+	setNotificationPolicy (TaskContext::NotificationPolicy (30.0, 0.001));
 	setTaskContext(handler);
 	addAndMakeVisible(&nameLabel);
 
@@ -199,7 +203,7 @@ void TaskContextListBoxModel::ItemComponent::resized ()
 
 void TaskContextListBoxModel::ItemComponent::taskProgressChanged (TaskContext& context)
 {
-	progress = context.getTask().getProgress();
+	progress = context.getOverallProgress();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -290,7 +294,12 @@ void PooledTaskListView::getAllTaskHandlers (TaskContextArray& tasks)
 	n = taskRunner.getNumTasks();
 	for (int i = 0; i < n; i++)
 	{
-		tasks.add (taskRunner.getTaskContext(i));
+		// Tasks may finish while we're iterating, so skip any that have gone.
+		TaskContext* context = taskRunner.getTaskContext(i);
+		if (context != nullptr)
+		{
+			tasks.add (context);
+		}
 	}
 //	n = taskRunner.getNumUnfinishedTasks ();
 //	for (int i = 0; i < n; i++)
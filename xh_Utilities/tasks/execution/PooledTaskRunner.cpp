@@ -1,26 +1,152 @@
 
 ///////////////////////////////////////////////////////////////////////////////
 
-class TaskThreadPool::IdSelector	:	public ThreadPool::JobSelector
+/** The jobs in the pool which share an id. */
+class TaskThreadPool::IdBucket
 {
 public:
-    
-	IdSelector (Identifier id)
-	:	idToMatch (id)
+
+	IdBucket () {}
+
+	Array< Job* > jobs;
+
+	JUCE_DECLARE_NON_COPYABLE (IdBucket);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+/** A ResumableTask which is waiting between steps. Whatever it is waiting
+	for holds a reference to this, so it can still be safely resumed after
+	the pool has gone (in which case nothing happens). */
+class TaskThreadPool::SuspendedTask	:	public TaskContext::WakeUpHandler
+{
+public:
+
+	typedef ReferenceCountedObjectPtr< SuspendedTask > Ptr;
+
+	SuspendedTask (TaskThreadPool& owner_, TaskContext* context_, Priority priority_)
+		:	context (context_),
+			priority (priority_),
+			wakeTime (0),
+			owner (&owner_)
 	{
 	}
-    
-	virtual ~IdSelector ()
+
+	/** Puts the task back into the pool's queue, unless it has already been
+		resumed. */
+	void resume ()
 	{
+		ScopedLock sl (lock);
+
+		if (owner != nullptr)
+			owner->resumeSuspendedTask (this);
 	}
-    
-	virtual bool isJobSuitable (ThreadPoolJob *job) override
+
+	/** Called if the task is aborted while it's waiting. */
+	virtual void wakeUp () override
 	{
-		Job* taskJob = static_cast< Job* >(job);
-		return (taskJob != nullptr) && (taskJob->getId() == idToMatch);
+		resume ();
 	}
-    
-	Identifier idToMatch;
+
+	/** Called when the pool is deleted. */
+	void detach ()
+	{
+		ScopedLock sl (lock);
+		owner = nullptr;
+	}
+
+	TaskContext::Ptr context;
+	const Priority priority;
+	uint32 wakeTime;
+
+private:
+
+	CriticalSection lock;
+	TaskThreadPool* owner;
+
+	JUCE_DECLARE_NON_COPYABLE (SuspendedTask);
+};
+
+/** Resumes a task once the context it's waiting for has finished. */
+class TaskThreadPool::ResumeContinuation	:	public TaskContext::Continuation
+{
+public:
+
+	ResumeContinuation (SuspendedTask* task_) : task (task_) {}
+
+	virtual ProgressiveTask* createNextTask (TaskContext&) override
+	{
+		task->resume ();
+		return nullptr;
+	}
+
+private:
+
+	SuspendedTask::Ptr task;
+};
+
+/** Resumes sleeping tasks when their time is up. This is only started if
+	a task actually sleeps. */
+class TaskThreadPool::Resumer	:	public Thread
+{
+public:
+
+	Resumer () : Thread ("TaskThreadPool resumer") {}
+
+	~Resumer ()
+	{
+		stopThread (5000);
+	}
+
+	void add (SuspendedTask* task)
+	{
+		{
+			ScopedLock sl (lock);
+			sleepingTasks.add (task);
+		}
+		notify ();
+	}
+
+	virtual void run () override
+	{
+		while (! threadShouldExit ())
+		{
+			ReferenceCountedArray< SuspendedTask > dueTasks;
+			int timeOut = -1;
+
+			{
+				ScopedLock sl (lock);
+				const uint32 now = Time::getMillisecondCounter ();
+
+				for (int i = sleepingTasks.size(); --i >= 0;)
+				{
+					SuspendedTask* task = sleepingTasks.getObjectPointerUnchecked (i);
+					const int remaining = (int) (task->wakeTime - now);
+
+					if (remaining <= 0)
+					{
+						dueTasks.add (task);
+						sleepingTasks.remove (i);
+					}
+					else if (timeOut < 0 || remaining < timeOut)
+					{
+						timeOut = remaining;
+					}
+				}
+			}
+
+			for (int i = 0; i < dueTasks.size(); ++i)
+				dueTasks.getObjectPointerUnchecked (i)->resume ();
+
+			if (dueTasks.size() == 0)
+				wait (timeOut);
+		}
+	}
+
+private:
+
+	CriticalSection lock;
+	ReferenceCountedArray< SuspendedTask > sleepingTasks;	// guarded by lock
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -28,12 +154,21 @@ public:
 TaskThreadPool::Job::Job (TaskContext* context, TaskThreadPool& owner_)
 :	ThreadPoolJob (context != nullptr ? context->getTask().getName() : String::empty),
     taskContext (context),
-    owner (owner_)
+    owner (owner_),
+    runningThreadId (nullptr),
+	priority (normalPriority),
+	serial (0)
 {
 }
 
 TaskThreadPool::Job::~Job ()
 {
+	// A job which is deleted without having been run (e.g. when the pool's
+	// tasks are all removed) still has to finish its context.
+	if (runState.get() != jobRunning)
+		abortTask (taskContext);
+
+	owner.unregisterJob (*this);
 	taskContext = nullptr;
 }
 
@@ -47,20 +182,68 @@ TaskContext* TaskThreadPool::Job::getTaskContext()
 	return taskContext;
 }
 
+TaskThreadPool::Priority TaskThreadPool::Job::getPriority () const
+{
+	return priority;
+}
+
+typedef RecyclingAllocator< sizeof (TaskThreadPool::Job) > TaskJobAllocator;
+
+void* TaskThreadPool::Job::operator new (size_t size)
+{
+	return TaskJobAllocator::allocate (size);
+}
+
+void TaskThreadPool::Job::operator delete (void* block, size_t size)
+{
+	TaskJobAllocator::deallocate (block, size);
+}
+
+bool TaskThreadPool::Job::wasCancelled () const
+{
+	return runState.get() == jobCancelled;
+}
+
+bool TaskThreadPool::Job::cancel ()
+{
+	// This only succeeds if the job hasn't started yet.
+	return runState.compareAndSetBool (jobCancelled, jobQueued);
+}
+
 juce::Identifier TaskThreadPool::Job::getId () const
 {
 	if (taskContext != nullptr)
 	{
-		//return taskHandler->getId();
+		return taskContext->getId();
 	}
 	return Identifier::null;
 }
 
 ThreadPoolJob::JobStatus TaskThreadPool::Job::runJob ()
 {
+	// A cancelled job is simply dropped when it reaches the front of the
+	// queue, rather than being searched for and removed when it's cancelled.
+	// Its context still has to finish, as something may be waiting for it.
+	if (! runState.compareAndSetBool (jobRunning, jobQueued))
+	{
+		abortTask (taskContext);
+		owner.jobFinishedInternal (*this);
+		return ThreadPoolJob::jobHasFinished;
+	}
+
 	if (taskContext != nullptr)
 	{
+		runningThreadId.set (Thread::getCurrentThreadId ());
 		runTask (taskContext);
+		runningThreadId.set (nullptr);
+
+		// A ResumableTask waiting between steps isn't finished; the pool
+		// will give it a new job when it's ready to continue.
+		if (taskContext->isSuspended ())
+		{
+			owner.suspendJob (*this);
+			return ThreadPoolJob::jobHasFinished;
+		}
 	}
     
     owner.jobFinishedInternal (*this);
@@ -75,74 +258,487 @@ bool TaskThreadPool::Job::currentTaskShouldExit ()
 
 bool TaskThreadPool::Job::isCurrentTaskThread ()
 {
-	return getCurrentThreadPoolJob() == this;
+	// The job might be run by a WorkStealingTaskScheduler rather than a
+	// juce::ThreadPool, so getCurrentThreadPoolJob() can't be used here.
+	return runningThreadId.get () == Thread::getCurrentThreadId ();
 }
 
+bool TaskThreadPool::Job::canSuspendTasks ()
+{
+	return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/** Periodically samples the scheduler's statistics, and resizes an adaptive
+	pool based on them. */
+class TaskThreadPool::SizeTuner	:	public Thread
+{
+public:
+
+	SizeTuner (TaskThreadPool& owner_)
+		:	Thread ("TaskThreadPool tuner"),
+			owner (owner_),
+			lastThroughput (0.0),
+			lastChange (0),
+			samplesToHold (0)
+	{
+	}
+
+	~SizeTuner ()
+	{
+		stopThread (2000);
+	}
+
+	virtual void run () override
+	{
+		TaskScheduler::Statistics previous (owner.scheduler->getStatistics ());
+		int64 previousTicks = Time::getHighResolutionTicks ();
+
+		while (! threadShouldExit ())
+		{
+			wait (sampleIntervalMs);
+
+			if (threadShouldExit ())
+				break;
+
+			const TaskScheduler::Statistics current (owner.scheduler->getStatistics ());
+			const int64 ticks = Time::getHighResolutionTicks ();
+
+			adjust (previous, current, Time::highResolutionTicksToSeconds (ticks - previousTicks));
+
+			previous = current;
+			previousTicks = ticks;
+		}
+	}
+
+private:
+
+	enum { sampleIntervalMs = 250 };
+
+	void adjust (const TaskScheduler::Statistics& previous, const TaskScheduler::Statistics& current, double seconds)
+	{
+		const int numWorkers = jmax (1, current.numThreads);
+
+		if (seconds <= 0.0)
+			return;
+
+		const double throughput = (current.numJobsRun - previous.numJobsRun) / seconds;
+		const double busySeconds = current.busySeconds - previous.busySeconds;
+
+		// The proportion of the workers' time spent running jobs...
+		const double busy = busySeconds / (seconds * numWorkers);
+
+		// ...and the proportion of that spent blocked, rather than using CPU.
+		double blocked = 0.0;
+		if (current.cpuSeconds >= 0.0 && previous.cpuSeconds >= 0.0 && busySeconds > 0.0)
+			blocked = jlimit (0.0, 1.0, 1.0 - (current.cpuSeconds - previous.cpuSeconds) / busySeconds);
+
+		int change = 0;
+
+		if (lastChange > 0 && throughput < lastThroughput * 0.95)
+		{
+			// The extra worker made things worse (probably by contending with
+			// the others), so take it away and leave things alone for a bit.
+			change = -1;
+			samplesToHold = 8;
+		}
+		else if (samplesToHold > 0)
+		{
+			--samplesToHold;
+		}
+		else if (current.numQueuedJobs > 0 && busy > 0.9)
+		{
+			if (numWorkers < SystemStats::getNumCpus () || blocked > 0.25)
+				change = 1;
+		}
+		else if (current.numQueuedJobs == 0 && busy < 0.5)
+		{
+			change = -1;
+		}
+
+		lastThroughput = throughput;
+		lastChange = 0;
+
+		if (change != 0)
+		{
+			owner.setNumWorkers (numWorkers + change);
+			lastChange = owner.getNumWorkers () - numWorkers;
+		}
+	}
+
+	TaskThreadPool& owner;
+	double lastThroughput;
+	int lastChange;
+	int samplesToHold;
+
+	JUCE_DECLARE_NON_COPYABLE (SizeTuner);
+};
 
 ///////////////////////////////////////////////////////////////////////////////
 
-TaskThreadPool::TaskThreadPool (int maxConcurrentTasks)
+TaskThreadPool::TaskThreadPool (int maxConcurrentTasks, SchedulerType type)
 :	itemsChangedFunc (*this, &TaskThreadPool::itemsChanged),
-    maxConcurrentTaskLimit (maxConcurrentTasks)
+	sizeChangedFunc (*this, &TaskThreadPool::sizeChanged),
+    schedulerType (type),
+    maxConcurrentTaskLimit (jmax (1, maxConcurrentTasks)),
+	minWorkers (1),
+	maxWorkers (jmax (1, maxConcurrentTasks)),
+	resultCache (nullptr),
+	lastJobSerial (0)
 {
 	OwnedArray<ThreadPoolJob> leakDetectorRaceConditionDummy;
 
-	pool = new ThreadPool (maxConcurrentTaskLimit);
+	static_jassert (highPriority + 1 == TaskScheduler::numPriorities);
+
+	if (schedulerType == threadPoolScheduler)
+		scheduler = new ThreadPoolTaskScheduler (maxConcurrentTaskLimit);
+	else
+		scheduler = new WorkStealingTaskScheduler (maxConcurrentTaskLimit);
+
+	if (schedulerType == adaptiveScheduler)
+	{
+		scheduler->setNumThreads (jlimit (1, maxConcurrentTaskLimit, SystemStats::getNumCpus ()));
+
+		sizeTuner = new SizeTuner (*this);
+		sizeTuner->startThread ();
+	}
 }
 
 TaskThreadPool::~TaskThreadPool ()
 {
-	pool->removeAllJobs (true, 5000);
-	pool = nullptr;
+	sizeTuner = nullptr;
+	scheduler->removeAllJobs (true, 5000);
+
+	// Anything still suspended can never be resumed now, so it's finished
+	// as aborted.
+	ReferenceCountedArray< SuspendedTask > tasks;
+	{
+		ScopedLock lock (listSection);
+		tasks.swapWith (suspendedTasks);
+	}
+
+	for (int i = 0; i < tasks.size(); ++i)
+	{
+		SuspendedTask* task = tasks.getObjectPointerUnchecked (i);
+		task->detach ();
+		TaskThreadBase::abortTask (task->context);
+	}
+
+	resumer = nullptr;
+	scheduler = nullptr;
+
+	// Deleting the jobs should have emptied these.
+	jassert (jobsById.size() == 0);
+
+	for (HashMap< String, IdBucket* >::Iterator i (jobsById); i.next();)
+		delete i.getValue ();
+}
+
+TaskThreadPool::SchedulerType TaskThreadPool::getSchedulerType () const
+{
+	return schedulerType;
+}
+
+int TaskThreadPool::getMaxConcurrentTasks () const
+{
+	return maxConcurrentTaskLimit;
+}
+
+int TaskThreadPool::getNumWorkers () const
+{
+	return scheduler->getNumThreads ();
+}
+
+void TaskThreadPool::setWorkerLimits (int newMinWorkers, int newMaxWorkers)
+{
+	// Only an adaptive pool resizes itself.
+	jassert (schedulerType == adaptiveScheduler);
+
+	newMinWorkers = jlimit (1, maxConcurrentTaskLimit, newMinWorkers);
+	newMaxWorkers = jlimit (newMinWorkers, maxConcurrentTaskLimit, newMaxWorkers);
+
+	minWorkers = newMinWorkers;
+	maxWorkers = newMaxWorkers;
+
+	if (schedulerType == adaptiveScheduler)
+		setNumWorkers (getNumWorkers ());
+}
+
+void TaskThreadPool::setResultCache (TaskResultCache* cache)
+{
+	resultCache = cache;
+}
+
+TaskResultCache* TaskThreadPool::getResultCache () const
+{
+	return resultCache;
+}
+
+bool TaskThreadPool::completeFromCache (TaskContext& context)
+{
+	if (context.getResultCache () == nullptr)
+		context.setResultCache (resultCache);
+
+	return context.runFromCache ();
+}
+
+bool TaskThreadPool::setCpuAffinity (const BigInteger& cpus)
+{
+	return scheduler->setCpuAffinity (cpus);
+}
+
+void TaskThreadPool::createPoolsForCpuSets (const Array< BigInteger >& cpuSets, OwnedArray< TaskThreadPool >& pools,
+											 SchedulerType type)
+{
+	// The juce::ThreadPool's threads can't be pinned.
+	jassert (type != threadPoolScheduler);
+
+	for (int i = 0; i < cpuSets.size(); ++i)
+	{
+		const BigInteger& cpus = cpuSets.getReference (i);
+
+		if (cpus.isZero ())
+			continue;
+
+		TaskThreadPool* pool = pools.add (new TaskThreadPool (cpus.countNumberOfSetBits (), type));
+		pool->setCpuAffinity (cpus);
+	}
+}
+
+void TaskThreadPool::setNumWorkers (int numWorkers)
+{
+	const int oldNumWorkers = getNumWorkers ();
+	numWorkers = jlimit (minWorkers.get(), maxWorkers.get(), numWorkers);
+
+	if (numWorkers != oldNumWorkers && scheduler->setNumThreads (numWorkers))
+	{
+		if (listeners.size() > 0)
+			sizeChangedFunc.trigger ();
+	}
+}
+
+void TaskThreadPool::sizeChanged ()
+{
+	listeners.call (&Listener::poolSizeChanged, *this);
 }
 
 int TaskThreadPool::getNumTasks () const
 {
-	ScopedLock lock(getLock());
-	return pool->getNumJobs ();
+	return scheduler->getNumJobs ();
 }
 
 TaskContext* TaskThreadPool::getTaskContext (int index) const
 {
-	ScopedLock lock(getLock());
-	Job* job = dynamic_cast< Job* > (pool->getJob (index));
-	if (job != nullptr)
+	Job* job = dynamic_cast< Job* > (scheduler->getJob (index));
+	if (job != nullptr && ! job->wasCancelled ())
 	{
 		return job->getTaskContext();
 	}
 	return nullptr;
 }
 
-TaskContext& TaskThreadPool::addTask (ProgressiveTask* taskToRun, Identifier id)
+TaskContext* TaskThreadPool::getTaskContextWithId (Identifier id) const
+{
+	ScopedLock lock (listSection);
+
+	IdBucket* bucket = jobsById [id.toString()];
+	if (bucket != nullptr)
+	{
+		for (int i = 0; i < bucket->jobs.size(); ++i)
+		{
+			Job* job = bucket->jobs.getUnchecked (i);
+			if (! job->wasCancelled ())
+				return job->getTaskContext ();
+		}
+	}
+	return nullptr;
+}
+
+int TaskThreadPool::getNumSuspendedTasks () const
+{
+	ScopedLock lock (listSection);
+	return suspendedTasks.size();
+}
+
+TaskContext& TaskThreadPool::addTask (ProgressiveTask* taskToRun, Identifier id, Priority priority)
 {
 	TaskContext* context = createContextForTask (taskToRun);
 
 	if (context == nullptr)
 		context = new TaskContext (taskToRun);
 
-    //context->setId (id);
+	if (id != Identifier::null)
+		context->setId (id);
     
-	addContextToPool (context);
+	addContextToPool (context, priority);
 	return *context;
 }
 
-void TaskThreadPool::addTask (TaskContext* context)
+void TaskThreadPool::addTask (TaskContext* context, Priority priority)
 {
     if (context != nullptr)
     {
-        addContextToPool (context);
+        addContextToPool (context, priority);
     }
 }
 
+void TaskThreadPool::addTasks (const Array< ProgressiveTask* >& tasksToRun, Priority priority,
+							   ReferenceCountedArray< TaskContext >* contexts)
+{
+	ReferenceCountedArray< TaskContext > newContexts;
+	newContexts.ensureStorageAllocated (tasksToRun.size());
+
+	for (int i = 0; i < tasksToRun.size(); ++i)
+	{
+		TaskContext* context = createContextForTask (tasksToRun.getUnchecked (i));
+
+		if (context == nullptr)
+			context = new TaskContext (tasksToRun.getUnchecked (i));
+
+		newContexts.add (context);
+	}
+
+	addTasks (newContexts, priority);
+
+	if (contexts != nullptr)
+		contexts->addArray (newContexts);
+}
+
+void TaskThreadPool::addTasks (const ReferenceCountedArray< TaskContext >& contextsToRun, Priority priority)
+{
+	Array< Job* > jobs;
+	jobs.ensureStorageAllocated (contextsToRun.size());
+
+	for (int i = 0; i < contextsToRun.size(); ++i)
+	{
+		TaskContext* context = contextsToRun.getObjectPointerUnchecked (i);
+
+		if (context != nullptr && ! completeFromCache (*context))
+			jobs.add (createJob (context, priority));
+	}
+
+	if (jobs.size() == 0)
+		return;
+
+	{
+		// Taken once for the whole batch; registerJob() re-enters it. As in
+		// addContextToPool(), the hook is called before the job is queued.
+		ScopedLock lock (listSection);
+
+		for (int i = 0; i < jobs.size(); ++i)
+		{
+			registerJob (*jobs.getUnchecked (i));
+			taskJobAdded (*jobs.getUnchecked (i));
+		}
+	}
+
+	Array< ThreadPoolJob* > poolJobs;
+	poolJobs.ensureStorageAllocated (jobs.size());
+
+	for (int i = 0; i < jobs.size(); ++i)
+		poolJobs.add (jobs.getUnchecked (i));
+
+	scheduler->addJobs (poolJobs, (int) priority);
+
+	triggerItemsChanged ();
+}
+
 bool TaskThreadPool::removeAllTasks (bool interruptRunningJobs, int timeOutMilliseconds)
 {
-	return pool->removeAllJobs (interruptRunningJobs, timeOutMilliseconds);
+	if (interruptRunningJobs)
+	{
+		ReferenceCountedArray< SuspendedTask > tasks;
+		{
+			ScopedLock lock (listSection);
+			tasks = suspendedTasks;
+		}
+
+		resumeAbortedTasks (tasks);
+	}
+
+	return scheduler->removeAllJobs (interruptRunningJobs, timeOutMilliseconds);
 }
 
 bool TaskThreadPool::removeAllTasksWithId (juce::Identifier id, bool interruptRunningJobs, int timeOutMilliseconds)
 {
-    IdSelector selector (id);
-	return pool->removeAllJobs (interruptRunningJobs, timeOutMilliseconds, &selector);
+	if (id == Identifier::null)
+		return true;
+
+	const String key (id.toString());
+	Array< int64 > runningJobSerials;
+	ReferenceCountedArray< SuspendedTask > suspendedJobs;
+
+	{
+		ScopedLock lock (listSection);
+
+		if (interruptRunningJobs)
+		{
+			for (int i = 0; i < suspendedTasks.size(); ++i)
+			{
+				SuspendedTask* task = suspendedTasks.getObjectPointerUnchecked (i);
+
+				if (task->context->getId () == id)
+					suspendedJobs.add (task);
+			}
+		}
+
+		IdBucket* bucket = jobsById [key];
+		if (bucket == nullptr)
+			return true;
+
+		for (int i = bucket->jobs.size(); --i >= 0;)
+		{
+			Job* job = bucket->jobs.getUnchecked (i);
+
+			if (job->cancel ())
+			{
+				bucket->jobs.remove (i);
+				job->registeredKey = String::empty;
+			}
+			else
+			{
+				if (interruptRunningJobs)
+				{
+					job->signalJobShouldExit ();
+
+					// Aborting the task as well means it sees this at once.
+					if (job->getTaskContext () != nullptr)
+						job->getTaskContext ()->getTask().abort ();
+				}
+
+				runningJobSerials.add (job->serial);
+			}
+		}
+
+		if (bucket->jobs.size() == 0)
+		{
+			jobsById.remove (key);
+			delete bucket;
+		}
+	}
+
+	// These are resumed after the queued jobs have been cancelled, so that
+	// their new jobs aren't cancelled too.
+	resumeAbortedTasks (suspendedJobs);
+
+	triggerItemsChanged ();
+
+	const uint32 start = Time::getMillisecondCounter ();
+
+	for (int i = runningJobSerials.size(); --i >= 0;)
+	{
+		while (isJobRegistered (key, runningJobSerials.getUnchecked (i)))
+		{
+			if (timeOutMilliseconds >= 0 && Time::getMillisecondCounter () >= start + (uint32) timeOutMilliseconds)
+				return false;
+
+			Thread::sleep (2);
+		}
+	}
+
+	return true;
 }
 
 TaskContext* TaskThreadPool::createContextForTask (ProgressiveTask* task)
@@ -170,7 +766,27 @@ const CriticalSection& TaskThreadPool::getLock () const
 	return listSection;
 }
 
-void TaskThreadPool::addContextToPool (TaskContext* context)
+void TaskThreadPool::addContextToPool (TaskContext* context, Priority priority)
+{
+	if (completeFromCache (*context))
+		return;
+
+	Job* job = createJob (context, priority);
+
+	// The hook is called under the lock, and before the job is queued, so
+	// it always comes before taskJobFinished() for the same job.
+	{
+		ScopedLock lock (listSection);
+		registerJob (*job);
+		taskJobAdded (*job);
+	}
+
+	scheduler->addJob (job, (int) priority);
+	
+	triggerItemsChanged ();
+}
+
+TaskThreadPool::Job* TaskThreadPool::createJob (TaskContext* context, Priority priority)
 {
 	Job* job = createJobForContext (context);
 
@@ -179,21 +795,174 @@ void TaskThreadPool::addContextToPool (TaskContext* context)
         job = new Job (context, *this);
     }
 
-    // Add to the pool...
-    {
-        ScopedLock lock (getLock());
-        pool->addJob (job, true);
-        taskJobAdded (*job);
-    }
-	
-	itemsChangedFunc.trigger();
+    job->priority = priority;
+	return job;
+}
+
+TaskThreadPool::Job* TaskThreadPool::queueContext (TaskContext* context, Priority priority)
+{
+	Job* job = createJob (context, priority);
+    registerJob (*job);
+
+    // The scheduler does its own locking, so there's no need to serialise
+    // producers here.
+    scheduler->addJob (job, (int) priority);
+	return job;
+}
+
+void TaskThreadPool::suspendJob (Job& job)
+{
+	TaskContext* context = job.getTaskContext ();
+	const ResumableTask::Step step (dynamic_cast< ResumableTask& > (context->getTask()).getPendingStep ());
+
+	SuspendedTask::Ptr task (new SuspendedTask (*this, context, job.getPriority ()));
+
+	{
+		ScopedLock lock (listSection);
+		suspendedTasks.add (task);
+	}
+
+	// If the task's deadline passes while it's waiting, it's resumed early.
+	context->setWakeUpHandler (task);
+
+	switch (step.getType ())
+	{
+	case ResumableTask::Step::sleepStep:
+		{
+			task->wakeTime = Time::getMillisecondCounter () + (uint32) step.getSleepTime ();
+
+			ScopedLock lock (listSection);
+
+			if (resumer == nullptr)
+			{
+				resumer = new Resumer ();
+				resumer->startThread ();
+			}
+
+			resumer->add (task);
+		}
+		break;
+
+	case ResumableTask::Step::waitStep:
+
+		// If the other context has already finished, this resumes the task
+		// straight away.
+		step.getContextToWaitFor ()->then (new ResumeContinuation (task), *this);
+		break;
+
+	default:
+
+		task->resume ();
+		break;
+	}
+}
+
+void TaskThreadPool::resumeSuspendedTask (SuspendedTask* task)
+{
+	{
+		ScopedLock lock (listSection);
+
+		// It may already have been resumed by removeAllTasks().
+		if (! suspendedTasks.contains (task))
+			return;
+
+		suspendedTasks.removeObject (task);
+	}
+
+	queueContext (task->context, task->priority);
+}
+
+void TaskThreadPool::resumeAbortedTasks (const ReferenceCountedArray< SuspendedTask >& tasks)
+{
+	for (int i = 0; i < tasks.size(); ++i)
+	{
+		SuspendedTask* task = tasks.getObjectPointerUnchecked (i);
+		task->context->getTask().abort ();
+		task->resume ();
+	}
+}
+
+void TaskThreadPool::registerJob (Job& job)
+{
+	const Identifier id (job.getId ());
+	if (id == Identifier::null)
+		return;
+
+	const String key (id.toString());
+	ScopedLock lock (listSection);
+
+	IdBucket* bucket = jobsById [key];
+	if (bucket == nullptr)
+	{
+		bucket = new IdBucket ();
+		jobsById.set (key, bucket);
+	}
+
+	bucket->jobs.add (&job);
+
+	// The context's id could be changed later, so the job remembers which
+	// bucket it went in. Jobs' memory is recycled, so they're told apart by
+	// serial number rather than by address.
+	job.registeredKey = key;
+	job.serial = ++lastJobSerial;
+}
+
+void TaskThreadPool::unregisterJob (Job& job)
+{
+	ScopedLock lock (listSection);
+
+	const String key (job.registeredKey);
+	if (key.isEmpty ())
+		return;
+
+	job.registeredKey = String::empty;
+
+	IdBucket* bucket = jobsById [key];
+	if (bucket != nullptr)
+	{
+		bucket->jobs.removeFirstMatchingValue (&job);
+
+		if (bucket->jobs.size() == 0)
+		{
+			jobsById.remove (key);
+			delete bucket;
+		}
+	}
+}
+
+bool TaskThreadPool::isJobRegistered (const String& key, int64 serial) const
+{
+	ScopedLock lock (listSection);
+
+	IdBucket* bucket = jobsById [key];
+	if (bucket == nullptr)
+		return false;
+
+	for (int i = 0; i < bucket->jobs.size(); ++i)
+	{
+		if (bucket->jobs.getUnchecked (i)->serial == serial)
+			return true;
+	}
+
+	return false;
 }
 
 void TaskThreadPool::jobFinishedInternal (TaskThreadPool::Job &taskJob)
 {
-	ScopedLock lock (getLock());
-    taskJobFinished (taskJob);
-    itemsChangedFunc.trigger ();
+	{
+		ScopedLock lock (listSection);
+		taskJobFinished (taskJob);
+	}
+
+    triggerItemsChanged ();
+}
+
+void TaskThreadPool::triggerItemsChanged ()
+{
+	// Without any listeners there's no need to post a message, which means
+	// that a pool can be used without a message loop.
+	if (listeners.size() > 0)
+		itemsChangedFunc.trigger ();
 }
 
 void TaskThreadPool::itemsChanged ()
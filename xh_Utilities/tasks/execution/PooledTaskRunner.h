@@ -3,6 +3,9 @@
 
 ///////////////////////////////////////////////////////////////////////////////
 /**
+	Runs TaskContexts on a pool of worker threads. The way in which jobs are
+	queued and distributed between the workers is determined by the
+	SchedulerType chosen when the pool is created.
 */
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -12,17 +15,151 @@ public:
 
 	///////////////////////////////////////////////////////////////////////////
 
-	TaskThreadPool (int maxConcurrentTasks = 1);
+	enum SchedulerType
+	{
+		/** Tasks are run on a juce::ThreadPool, which keeps all of its jobs
+			in a single list. */
+		threadPoolScheduler,
+
+		/** Tasks are run on a WorkStealingTaskScheduler, which keeps a job
+			deque per worker. This scales much better when lots of short
+			tasks are added from multiple threads. */
+		workStealingScheduler,
+
+		/** Tasks are run on a WorkStealingTaskScheduler, whose number of
+			active workers is tuned at run time (see setWorkerLimits()).
+			The pool's maxConcurrentTasks is the most it can grow to. */
+		adaptiveScheduler
+	};
+
+	/** The priority class a task is queued with. When the pool uses the
+		workStealingScheduler, higher priority tasks are started first, but
+		a task which has been kept waiting for too long will be started
+		ahead of them so that it isn't starved. The threadPoolScheduler
+		always starts tasks in the order they were added. */
+	enum Priority
+	{
+		lowPriority = 0,
+		normalPriority,
+		highPriority
+	};
+
+	TaskThreadPool (int maxConcurrentTasks = 1, SchedulerType schedulerType = threadPoolScheduler);
 	virtual ~TaskThreadPool ();
 
-	TaskContext& addTask (ProgressiveTask* taskToRun, juce::Identifier id = juce::Identifier::null);
-	void addTask (TaskContext* context);
+	/** Returns the type of scheduler this pool was created with. */
+	SchedulerType getSchedulerType () const;
+
+	/** Returns the maximum number of tasks this pool will run at once. */
+	int getMaxConcurrentTasks () const;
+
+	/** Returns the number of workers currently running tasks. For an
+		adaptive pool, this changes over time. */
+	int getNumWorkers () const;
+
+	/** Sets the range an adaptive pool may resize itself within. Both limits
+		are clamped to between 1 and getMaxConcurrentTasks(). An adaptive
+		pool starts with one worker per CPU (within these limits), and then
+		every quarter of a second:
+
+		- adds a worker if there are tasks waiting and the workers are
+		  saturated, and either there are spare CPUs or the running tasks
+		  are spending a good part of their time blocked;
+		- removes a worker if there's nothing waiting and the workers are
+		  mostly idle;
+		- undoes the last increase if it made the throughput worse.
+
+		Listeners are told whenever the size changes.
+	*/
+	void setWorkerLimits (int minWorkers, int maxWorkers);
+
+	/** Pins all of the pool's workers to a set of CPUs (bit n set for CPU n;
+		see CpuTopology). An empty set lets them run on any CPU again. This
+		isn't possible with the threadPoolScheduler, whose threads are
+		private to the juce::ThreadPool.
+
+		@returns	false if the pool's scheduler can't do this.
+	*/
+	bool setCpuAffinity (const juce::BigInteger& cpus);
+
+	/** Sets a cache which is given to every context added to the pool (unless
+		it already has one). A task whose result is in the cache completes
+		on the calling thread as soon as it's added, without being queued.
+		The pool doesn't own the cache. */
+	void setResultCache (TaskResultCache* cache);
+
+	/** Returns the pool's result cache, if it has one. */
+	TaskResultCache* getResultCache () const;
+
+	/** Creates one pool per set of CPUs, each with one worker per CPU in its
+		set and pinned to that set. For example, passing the result of
+		CpuTopology::getSystemTopology().getSharedCacheCpuSets (3) gives a
+		pool per L3 cache, so that tasks using the same data can be kept on
+		one socket by adding them to the same pool.
+	*/
+	static void createPoolsForCpuSets (const juce::Array< juce::BigInteger >& cpuSets,
+									   juce::OwnedArray< TaskThreadPool >& pools,
+									   SchedulerType schedulerType = workStealingScheduler);
+
+	/** Adds a task to the pool. If an id is given, it is set on the task's
+		context, so that the task can be found or removed using it later. */
+	TaskContext& addTask (ProgressiveTask* taskToRun, juce::Identifier id = juce::Identifier::null,
+						  Priority priority = normalPriority);
+
+	/** Adds a context to the pool, using whatever id it has been given. */
+	void addTask (TaskContext* context, Priority priority = normalPriority);
 
+	/** Adds a batch of tasks to the pool, all with the same priority. This is
+		much cheaper than adding them one at a time: the whole batch is handed
+		to the scheduler at once, and listeners only get a single
+		pooledTasksChanged() callback. The pool takes ownership of the tasks.
+
+		@param	tasksToRun	The tasks to add.
+		@param	priority	The priority class to queue them with.
+		@param	contexts	If this isn't null, the contexts created for the
+							tasks are added to it, in the same order.
+	*/
+	void addTasks (const juce::Array< ProgressiveTask* >& tasksToRun, Priority priority = normalPriority,
+				   juce::ReferenceCountedArray< TaskContext >* contexts = nullptr);
+
+	/** Adds a batch of contexts to the pool, using whatever ids they have
+		been given. See addTasks(). */
+	void addTasks (const juce::ReferenceCountedArray< TaskContext >& contextsToRun, Priority priority = normalPriority);
+
+	/** Removes all of the pool's tasks. Tasks which haven't started yet are
+		finished as aborted without being run, and running ones are
+		optionally interrupted and waited for. */
     bool removeAllTasks (bool interruptRunningTasks, int timeOutMilliseconds);
+
+	/** Removes all tasks with the given id. This only has to look at the
+		tasks with that id, not the whole queue. Tasks which haven't started
+		yet are cancelled straight away (they are skipped, rather than run,
+		when they reach the front of the queue), and running ones are
+		optionally interrupted and waited for.
+
+		@returns	true if all of the running tasks with this id finished
+					within the time-out period.
+	*/
 	bool removeAllTasksWithId (juce::Identifier id, bool interruptRunningTasks, int timeOutMilliseconds);
 
+	/** Returns the number of tasks in the pool, including any which have
+		been cancelled but not yet skipped by the scheduler. */
 	int getNumTasks () const;
+
+	/** Returns one of the pool's task contexts, or nullptr if the task at
+		that index has been cancelled. */
 	TaskContext* getTaskContext (int index) const;
+
+	/** Returns the context of a (queued or running) task with the given id,
+		or nullptr if there isn't one. */
+	TaskContext* getTaskContextWithId (juce::Identifier id) const;
+
+	/** Returns the number of ResumableTasks which are waiting between steps.
+		These aren't held by any worker, so they aren't counted by
+		getNumTasks(); they are put back into the queue as soon as they are
+		ready to continue. Removing tasks with interruptRunningTasks set
+		aborts any suspended ones, and resumes them so that they finish. */
+	int getNumSuspendedTasks () const;
     
     ///////////////////////////////////////////////////////
 
@@ -38,6 +175,17 @@ public:
         TaskThreadPool& getOwner ();
         
 		TaskContext* getTaskContext  ();
+
+		/** Returns the priority class the job was queued with. */
+		Priority getPriority () const;
+
+		/** Returns true if the job was cancelled before it started running. */
+		bool wasCancelled () const;
+
+		/** A job is created for every task added to a pool, so their memory
+			is recycled rather than going back to the heap each time. */
+		static void* operator new (size_t size);
+		static void operator delete (void* block, size_t size);
         
         juce::Identifier getId () const;
         
@@ -45,11 +193,29 @@ public:
         
         virtual bool currentTaskShouldExit () override;
 		virtual bool isCurrentTaskThread () override;
+		virtual bool canSuspendTasks () override;
 
     private:
         
         TaskContext::Ptr taskContext;
         TaskThreadPool& owner;
+        juce::Atomic< juce::Thread::ThreadID > runningThreadId;	// written by the worker, read from any thread
+		Priority priority;
+
+		enum RunState
+		{
+			jobQueued,
+			jobRunning,
+			jobCancelled
+		};
+
+		bool cancel ();
+
+		juce::Atomic< int > runState;
+		juce::String registeredKey;	// guarded by the owner's listSection
+		juce::int64 serial;			// guarded by the owner's listSection
+
+		friend class TaskThreadPool;
         
     };
 
@@ -60,6 +226,10 @@ public:
 	public:
 		virtual ~Listener () {};
 		virtual void pooledTasksChanged (TaskThreadPool& source) = 0;
+
+		/** Called (on the message thread) when an adaptive pool has changed
+			its number of workers. */
+		virtual void poolSizeChanged (TaskThreadPool& /*source*/) {}
 	};
 
     ///////////////////////////////////////////////////////
@@ -88,29 +258,63 @@ public:
     
 	virtual TaskContext* createContextForTask (ProgressiveTask* task);
     
+    /** Called when a job is added, with the pool's lock (see getLock())
+        held. This happens just before the job is queued, so it always comes
+        before taskJobFinished() for that job. */
     virtual void taskJobAdded (Job& ) {};
 
+    /** Called from the worker thread when a job has finished, with the
+        pool's lock (see getLock()) held. */
     virtual void taskJobFinished (Job& ) {};
     
 private:
     
-    class IdSelector;
+    class IdBucket;
+	class SuspendedTask;
+	class SizeTuner;
+	class ResumeContinuation;
+	class Resumer;
 	
-	void addContextToPool (TaskContext* task);
+	void registerJob (Job& job);
+	void unregisterJob (Job& job);
+	bool isJobRegistered (const juce::String& key, juce::int64 serial) const;
+
+	void addContextToPool (TaskContext* task, Priority priority);
+	Job* queueContext (TaskContext* context, Priority priority);
+	Job* createJob (TaskContext* context, Priority priority);
+	bool completeFromCache (TaskContext& context);
 	Job* createJobForContext (TaskContext* context);
     void jobFinishedInternal (Job& taskJob);
 
+	void suspendJob (Job& job);
+	void resumeSuspendedTask (SuspendedTask* task);
+	void resumeAbortedTasks (const juce::ReferenceCountedArray< SuspendedTask >& tasks);
+
 	void itemsChanged ();
+	void triggerItemsChanged ();
+
+	void setNumWorkers (int numWorkers);
+	void sizeChanged ();
 
 	typedef AsyncCallback< TaskThreadPool > AsyncFunc;
 	class CompleteCallback;
 
 	AsyncFunc itemsChangedFunc;
-	juce::ScopedPointer< juce::ThreadPool > pool;
+	AsyncFunc sizeChangedFunc;
+	juce::ScopedPointer< TaskScheduler > scheduler;
+	SchedulerType schedulerType;
    
     juce::ListenerList< Listener > listeners;
 	juce::CriticalSection listSection;
+	juce::HashMap< juce::String, IdBucket* > jobsById;	// guarded by listSection
+	juce::int64 lastJobSerial;	// guarded by listSection
+	juce::ReferenceCountedArray< SuspendedTask > suspendedTasks;	// guarded by listSection
+	juce::ScopedPointer< Resumer > resumer;	// created when first needed, under listSection
 	int maxConcurrentTaskLimit;
+	juce::Atomic< int > minWorkers;
+	juce::Atomic< int > maxWorkers;
+	juce::ScopedPointer< SizeTuner > sizeTuner;
+	TaskResultCache* resultCache;
 	
 };
 
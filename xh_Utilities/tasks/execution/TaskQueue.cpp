@@ -1,4 +1,139 @@
 
 ///////////////////////////////////////////////////////////////////////////////
 
+TaskQueue::TaskQueue (TaskThreadPool& poolToUse)
+	:	pool (poolToUse),
+		startingTasks (false),
+		needsNextTask (false)
+{
+}
+
+TaskQueue::~TaskQueue ()
+{
+	removeAllTasks (false);
+
+	TaskContext::Ptr context;
+	{
+		ScopedLock sl (lock);
+		context = currentContext;
+	}
+
+	// This waits for any callback from the context's thread to finish (the
+	// callback keeps our lock until it has removed itself, so if it has got
+	// as far as moving on from this context, it has already returned).
+	if (context != nullptr)
+		context->removeListener (this);
+}
+
+TaskContext& TaskQueue::addTask (ProgressiveTask* taskToRun)
+{
+	TaskContext* context = pool.createContextForTask (taskToRun);
+
+	if (context == nullptr)
+		context = new TaskContext (taskToRun);
+
+	addTask (context);
+	return *context;
+}
+
+void TaskQueue::addTask (TaskContext* context)
+{
+	if (context == nullptr)
+		return;
+
+	ScopedLock sl (lock);
+
+	pendingContexts.add (context);
+
+	if (currentContext == nullptr)
+		startNextTask ();
+}
+
+int TaskQueue::getNumTasks () const
+{
+	ScopedLock sl (lock);
+	return pendingContexts.size() + (currentContext != nullptr ? 1 : 0);
+}
+
+TaskContext* TaskQueue::getCurrentTaskContext () const
+{
+	ScopedLock sl (lock);
+	return currentContext;
+}
+
+void TaskQueue::removeAllTasks (bool abortRunningTask)
+{
+	ReferenceCountedArray< TaskContext > removedContexts;
+	{
+		ScopedLock sl (lock);
+
+		removedContexts.swapWith (pendingContexts);
+
+		if (abortRunningTask && currentContext != nullptr)
+			currentContext->getTask().abort ();
+	}
+
+	// The removed tasks will never run, but they still have to finish, as
+	// something may be waiting for them. This is done without the lock, as
+	// their callbacks and continuations may add more tasks.
+	for (int i = 0; i < removedContexts.size(); ++i)
+		TaskThreadBase::abortTask (removedContexts.getObjectPointerUnchecked (i));
+}
+
+TaskThreadPool& TaskQueue::getPool ()
+{
+	return pool;
+}
+
+void TaskQueue::startNextTask ()
+{
+	// Must be called with our lock held. A task whose result is cached is
+	// finished by the pool before addTask() returns, which calls back into
+	// here on the same thread; rather than recursing (once for every cached
+	// task in a row), that just sends this loop round again.
+	if (startingTasks)
+	{
+		needsNextTask = true;
+		return;
+	}
+
+	startingTasks = true;
+
+	do
+	{
+		needsNextTask = false;
+
+		if (pendingContexts.size() == 0)
+		{
+			currentContext = nullptr;
+			break;
+		}
+
+		currentContext = pendingContexts.getFirst ();
+		pendingContexts.remove (0);
+
+		currentContext->addListener (this);
+		pool.addTask (currentContext.getObject ());
+	}
+	while (needsNextTask);
+
+	startingTasks = false;
+}
+
+void TaskQueue::taskStateChanged (TaskContext& context)
+{
+	if (! context.hasFinished ())
+		return;
+
+	// This is called from the pool's worker thread. The listener is only
+	// removed once we've finished with the lock, so that our destructor (which
+	// removes it too) can't miss this callback and delete the queue under it.
+	ScopedLock sl (lock);
+
+	if (currentContext == &context)
+		startNextTask ();
+
+	context.removeListener (this);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
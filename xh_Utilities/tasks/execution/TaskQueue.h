@@ -4,9 +4,64 @@
 ///////////////////////////////////////////////////////////////////////////////
 /**
     A simple queue to be used for executing ProgressiveTasks.
+
+	Tasks added to a queue are run one at a time, in the order they were
+	added, but the queue doesn't have any threads of its own; each task is
+	handed to a shared TaskThreadPool once the one before it has finished.
+	This means you can have lots of queues (e.g. one per document) all
+	sharing the same few worker threads, while the tasks within each queue
+	still never overlap.
+
+	Note that the contexts of queued tasks should not be removed from the
+	pool directly; use removeAllTasks() instead.
 */
 ///////////////////////////////////////////////////////////////////////////////
 
+class TaskQueue	:	private TaskContext::Listener
+{
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TaskQueue);
+public:
+
+	/** Create a queue which runs its tasks on the given pool. The pool must
+		outlive the queue. */
+	TaskQueue (TaskThreadPool& poolToUse);
+	virtual ~TaskQueue ();
+
+	/** Adds a task to the end of the queue. The queue takes ownership of the
+		task (via the TaskContext created for it by the pool). */
+	TaskContext& addTask (ProgressiveTask* taskToRun);
+	void addTask (TaskContext* context);
+
+	/** Returns the number of tasks which are either waiting or running. */
+	int getNumTasks () const;
+
+	/** Returns the context of the task currently running (or about to be
+		run) on the pool, if there is one. */
+	TaskContext* getCurrentTaskContext () const;
+
+	/** Removes all of the tasks which have not yet been started, and
+		optionally aborts the one which is currently running. The removed
+		tasks' contexts are finished as aborted, without being run. */
+	void removeAllTasks (bool abortRunningTask);
+
+	TaskThreadPool& getPool ();
+
+private:
+
+	void startNextTask ();
+
+	virtual void taskStateChanged (TaskContext& context) override;
+	virtual void taskStatusMessageChanged (TaskContext&) override {}
+	virtual void taskProgressChanged (TaskContext&) override {}
+
+	TaskThreadPool& pool;
+	juce::CriticalSection lock;
+	juce::ReferenceCountedArray< TaskContext > pendingContexts;
+	TaskContext::Ptr currentContext;
+	bool startingTasks;		// guarded by lock
+	bool needsNextTask;		// guarded by lock
+
+};
 
 ///////////////////////////////////////////////////////////////////////////////
 
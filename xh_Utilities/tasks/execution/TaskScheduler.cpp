@@ -0,0 +1,65 @@
+///////////////////////////////////////////////////////////////////////////////
+
+TaskScheduler::Statistics::Statistics ()
+	:	numJobsRun (0),
+		busySeconds (0.0),
+		cpuSeconds (-1.0),
+		numQueuedJobs (0),
+		numThreads (0)
+{
+}
+
+TaskScheduler::Statistics TaskScheduler::getStatistics () const
+{
+	Statistics stats;
+	stats.numQueuedJobs = getNumJobs ();
+	stats.numThreads = getNumThreads ();
+	return stats;
+}
+
+void TaskScheduler::addJobs (const Array< ThreadPoolJob* >& jobs, int priority)
+{
+	for (int i = 0; i < jobs.size(); ++i)
+		addJob (jobs.getUnchecked (i), priority);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+ThreadPoolTaskScheduler::ThreadPoolTaskScheduler (int numberOfThreads)
+{
+	pool = new ThreadPool (numberOfThreads);
+}
+
+ThreadPoolTaskScheduler::~ThreadPoolTaskScheduler ()
+{
+	pool->removeAllJobs (true, 5000);
+	pool = nullptr;
+}
+
+void ThreadPoolTaskScheduler::addJob (ThreadPoolJob* job, int /*priority*/)
+{
+	pool->addJob (job, true);
+}
+
+int ThreadPoolTaskScheduler::getNumJobs () const
+{
+	return pool->getNumJobs ();
+}
+
+ThreadPoolJob* ThreadPoolTaskScheduler::getJob (int index) const
+{
+	return pool->getJob (index);
+}
+
+bool ThreadPoolTaskScheduler::removeAllJobs (bool interruptRunningJobs, int timeOutMilliseconds,
+											 ThreadPool::JobSelector* selectedJobsToRemove)
+{
+	return pool->removeAllJobs (interruptRunningJobs, timeOutMilliseconds, selectedJobsToRemove);
+}
+
+int ThreadPoolTaskScheduler::getNumThreads () const
+{
+	return pool->getNumThreads ();
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,136 @@
+#ifndef TASKSCHEDULER_H_INCLUDED
+#define TASKSCHEDULER_H_INCLUDED
+
+///////////////////////////////////////////////////////////////////////////////
+/**
+	Interface for the engine used by a TaskThreadPool to execute its jobs.
+
+	A scheduler takes ownership of the juce::ThreadPoolJob objects given to
+	it, runs each of them on one of its worker threads, and deletes them
+	once they have finished (i.e. the same contract as calling
+	juce::ThreadPool::addJob (job, true)).
+*/
+///////////////////////////////////////////////////////////////////////////////
+
+class TaskScheduler
+{
+public:
+
+	TaskScheduler () {}
+	virtual ~TaskScheduler () {}
+
+	/** The number of priority classes a job can be given, from 0 (the
+		lowest) to numPriorities - 1 (the highest). */
+	enum { numPriorities = 3 };	// see TaskThreadPool::Priority
+
+	/** Queues a job for execution. The scheduler will delete the job once it
+		has finished running. Jobs with a higher priority should be started
+		ahead of those with a lower one, although a scheduler is free to
+		ignore this. */
+	virtual void addJob (juce::ThreadPoolJob* job, int priority) = 0;
+
+	/** Queues a batch of jobs, all with the same priority. By default this
+		just calls addJob() for each one, but a scheduler can override it to
+		queue the whole batch at once. */
+	virtual void addJobs (const juce::Array< juce::ThreadPoolJob* >& jobs, int priority);
+
+	/** Returns the number of jobs that are either queued or running. */
+	virtual int getNumJobs () const = 0;
+
+	/** Returns one of the queued or running jobs. This is only a snapshot, so
+		the job could finish at any time after this returns. */
+	virtual juce::ThreadPoolJob* getJob (int index) const = 0;
+
+	/** Removes any queued jobs that match the selector (or all of them, if the
+		selector is null), optionally interrupting matching jobs which are
+		already running, and waits for those to finish.
+
+		@returns	true if all matching jobs were removed or finished within
+					the time-out period.
+	*/
+	virtual bool removeAllJobs (bool interruptRunningJobs, int timeOutMilliseconds,
+								juce::ThreadPool::JobSelector* selectedJobsToRemove = nullptr) = 0;
+
+	/** Returns the number of worker threads used to run jobs. */
+	virtual int getNumThreads () const = 0;
+
+	/** Changes the number of worker threads used to run jobs, if the
+		scheduler supports it. A scheduler may limit this to the number of
+		threads it was created with.
+
+		@returns	false if the scheduler can't be resized.
+	*/
+	virtual bool setNumThreads (int /*newNumThreads*/)	{ return false; }
+
+	/** Restricts all of the worker threads to the given set of CPUs (see
+		CpuTopology), if the scheduler supports it.
+
+		@returns	false if the scheduler doesn't support this.
+	*/
+	virtual bool setCpuAffinity (const juce::BigInteger& /*cpus*/)	{ return false; }
+
+	/** Running totals describing how busy a scheduler has been. */
+	struct Statistics
+	{
+		Statistics ();
+
+		/** The number of jobs which have finished running. */
+		juce::int64 numJobsRun;
+
+		/** The total time the workers have spent running jobs. */
+		double busySeconds;
+
+		/** The total CPU time the workers have used while running jobs. The
+			difference between this and busySeconds is roughly the time jobs
+			spent blocked. This is negative if it can't be measured. */
+		double cpuSeconds;
+
+		/** The number of jobs waiting to be started. */
+		int numQueuedJobs;
+
+		/** The current number of worker threads. */
+		int numThreads;
+	};
+
+	/** Returns the scheduler's statistics. By default, only the queue size
+		and number of threads are filled in. */
+	virtual Statistics getStatistics () const;
+
+private:
+
+	JUCE_DECLARE_NON_COPYABLE (TaskScheduler);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/**
+	TaskScheduler which simply runs all of its jobs on a juce::ThreadPool.
+	All jobs are held in a single list, guarded by the pool's lock. The
+	juce::ThreadPool always runs its jobs in the order they were added, so
+	job priorities are ignored.
+*/
+///////////////////////////////////////////////////////////////////////////////
+
+class ThreadPoolTaskScheduler	:	public TaskScheduler
+{
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ThreadPoolTaskScheduler);
+public:
+
+	ThreadPoolTaskScheduler (int numberOfThreads);
+	virtual ~ThreadPoolTaskScheduler ();
+
+	virtual void addJob (juce::ThreadPoolJob* job, int priority) override;
+	virtual int getNumJobs () const override;
+	virtual juce::ThreadPoolJob* getJob (int index) const override;
+	virtual bool removeAllJobs (bool interruptRunningJobs, int timeOutMilliseconds,
+								juce::ThreadPool::JobSelector* selectedJobsToRemove = nullptr) override;
+	virtual int getNumThreads () const override;
+
+private:
+
+	juce::ScopedPointer< juce::ThreadPool > pool;
+
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif//TASKSCHEDULER_H_INCLUDED
@@ -42,9 +42,19 @@ Result TaskThread::runSynchronously (int priority)
 {
 	launchThread (priority, false);
 
-	while (!activeTask->hasFinished() || isThreadRunning())
-		MessageManager::getInstance()->runDispatchLoopUntil (5);
+	if (activeTask->getDispatcher().isDispatchThread() && MessageManager::getInstanceWithoutCreating() != nullptr)
+	{
+		// The completion callbacks will be sent to this thread, so the
+		// message loop needs to keep running while we wait.
+		while (!activeTask->hasFinished() || isThreadRunning())
+			MessageManager::getInstance()->runDispatchLoopUntil (5);
+	}
+	else
+	{
+		waitForThreadToExit (-1);
+	}
 
+	activeTask->flush ();
 	return activeTask->getResult();
 }
 
@@ -59,7 +59,7 @@ void TaskThreadWithProgressWindow::run ()
 {
 // 	if (getTask!= nullptr)
 // 	{
-		task->addListener (this);
+		task->addListener (this, TaskContext::NotificationPolicy (30.0, 0.001));
 
 		TaskThreadBase::runTask (task);
 //		result = task->run ();
@@ -125,12 +125,12 @@ TaskThreadWithProgressWindow& TaskThreadWithProgressWindow::runTask (Identifier
 
 void TaskThreadWithProgressWindow::taskStatusMessageChanged (TaskContext& context)
 {
-	setStatusMessage (context.getTask().getStatusMessage());
+	setStatusMessage (context.getOverallStatusMessage());
 }
 
 void TaskThreadWithProgressWindow::taskProgressChanged (TaskContext& context)
 {
-	setProgress (context.getTask().getProgress ());
+	setProgress (context.getOverallProgress ());
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,662 @@
+///////////////////////////////////////////////////////////////////////////////
+
+class WorkStealingTaskScheduler::JobDeque
+{
+public:
+
+	JobDeque ()
+		:	head (0),
+			numItems (0),
+			capacity (0)
+	{
+	}
+
+	int size () const
+	{
+		return numItems;
+	}
+
+	ThreadPoolJob* operator[] (int index) const
+	{
+		if (isPositiveAndBelow (index, numItems))
+			return items [(head + index) & (capacity - 1)].job;
+		return nullptr;
+	}
+
+	/** Returns the time at which the job at the front was queued. */
+	uint32 getTimeQueuedOfFront () const
+	{
+		jassert (numItems > 0);
+		return items [head].timeQueued;
+	}
+
+	void pushBack (ThreadPoolJob* job, uint32 timeQueued)
+	{
+		if (numItems == capacity)
+			grow ();
+
+		Item& item = items [(head + numItems) & (capacity - 1)];
+		item.job = job;
+		item.timeQueued = timeQueued;
+		++numItems;
+	}
+
+	ThreadPoolJob* popBack ()
+	{
+		if (numItems == 0)
+			return nullptr;
+
+		--numItems;
+		return items [(head + numItems) & (capacity - 1)].job;
+	}
+
+	ThreadPoolJob* popFront ()
+	{
+		if (numItems == 0)
+			return nullptr;
+
+		ThreadPoolJob* job = items [head].job;
+		head = (head + 1) & (capacity - 1);
+		--numItems;
+		return job;
+	}
+
+	/** Removes all jobs matching the selector (or all jobs, if it is null),
+		preserving the order of the rest. */
+	void removeMatching (ThreadPool::JobSelector* selector, Array< ThreadPoolJob* >& removedJobs)
+	{
+		int numKept = 0;
+
+		for (int i = 0; i < numItems; ++i)
+		{
+			const Item item (items [(head + i) & (capacity - 1)]);
+
+			if (selector == nullptr || selector->isJobSuitable (item.job))
+				removedJobs.add (item.job);
+			else
+				items [(head + numKept++) & (capacity - 1)] = item;
+		}
+
+		numItems = numKept;
+	}
+
+private:
+
+	void grow ()
+	{
+		const int newCapacity = jmax (32, capacity * 2);
+		HeapBlock< Item > newItems ((size_t) newCapacity);
+
+		for (int i = 0; i < numItems; ++i)
+			newItems [i] = items [(head + i) & (capacity - 1)];
+
+		items.swapWith (newItems);
+		head = 0;
+		capacity = newCapacity;
+	}
+
+	struct Item
+	{
+		ThreadPoolJob* job;
+		uint32 timeQueued;
+	};
+
+	HeapBlock< Item > items;
+	int head;
+	int numItems;
+	int capacity;	// always a power of two
+
+	JUCE_DECLARE_NON_COPYABLE (JobDeque);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+class WorkStealingTaskScheduler::Worker	:	public Thread
+{
+public:
+
+	Worker (WorkStealingTaskScheduler& owner_, int index_)
+		:	Thread ("Task worker " + String (index_ + 1)),
+			owner (owner_),
+			index (index_),
+			currentJob (nullptr),
+			currentJobPriority (0),
+			runGeneration (0),
+			appliedAffinityGeneration (0),
+			lastAgingCheckTime (0),
+			numJobsRun (0),
+			busySeconds (0.0),
+			cpuSeconds (0.0)
+	{
+	}
+
+	void run () override
+	{
+		while (! threadShouldExit ())
+		{
+			// A thread can only reliably set its own affinity, so each worker
+			// picks up changes itself.
+			if (owner.affinityGeneration.get() != appliedAffinityGeneration)
+				applyAffinity ();
+
+			if (index >= owner.numActiveWorkers.get())
+			{
+				// Parked until the scheduler grows again.
+				wait (500);
+				continue;
+			}
+
+			ThreadPoolJob* job = owner.findJobToRun (*this);
+
+			if (job != nullptr)
+			{
+				owner.runJob (*this, job);
+			}
+			else
+			{
+				// Mark ourselves idle before looking again, so that a job added
+				// in between can't be missed (its notify() will already be
+				// pending when we wait).
+				idle.set (1);
+
+				job = owner.findJobToRun (*this);
+				if (job != nullptr)
+				{
+					idle.set (0);
+					owner.runJob (*this, job);
+				}
+				else
+				{
+					wait (500);
+					idle.set (0);
+				}
+			}
+		}
+	}
+
+	WorkStealingTaskScheduler& owner;
+	const int index;
+
+	SpinLock lock;
+	JobDeque deques [TaskScheduler::numPriorities];
+	ThreadPoolJob* currentJob;
+	int currentJobPriority;
+	int64 runGeneration;	// bumped (under lock) each time a job stops running
+	Atomic< int > idle;
+	int appliedAffinityGeneration;
+	uint32 lastAgingCheckTime;	// only used by this worker's thread
+
+	// Statistics, guarded by lock.
+	int64 numJobsRun;
+	double busySeconds;
+	double cpuSeconds;
+
+	void applyAffinity ()
+	{
+		BigInteger cpus;
+		{
+			const SpinLock::ScopedLockType sl (owner.affinityLock);
+			cpus = owner.cpuAffinity;
+			appliedAffinityGeneration = owner.affinityGeneration.get();
+		}
+
+		CpuTopology::setCurrentThreadAffinity (cpus.isZero () ? CpuTopology::getSystemTopology ().getAllCpus ()
+															   : cpus);
+	}
+
+	/** Returns the CPU time used by the calling thread, or a negative value
+		if that can't be measured on this platform. */
+	static double getThreadCpuSeconds ()
+	{
+	   #if JUCE_LINUX || JUCE_ANDROID
+		timespec t;
+		if (clock_gettime (CLOCK_THREAD_CPUTIME_ID, &t) == 0)
+			return (double) t.tv_sec + t.tv_nsec * 1.0e-9;
+	   #endif
+		return -1.0;
+	}
+
+	JUCE_DECLARE_NON_COPYABLE (Worker);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+WorkStealingTaskScheduler::WorkStealingTaskScheduler (int numberOfThreads, int agingTimeMilliseconds)
+	:	numActiveWorkers (jmax (1, numberOfThreads)),
+		agingTime ((uint32) jmax (0, agingTimeMilliseconds))
+{
+	jassert (numberOfThreads > 0);
+
+	for (int i = 0; i < jmax (1, numberOfThreads); ++i)
+		workers.add (new Worker (*this, i));
+
+	for (int i = 0; i < workers.size(); ++i)
+		workers.getUnchecked (i)->startThread ();
+}
+
+WorkStealingTaskScheduler::~WorkStealingTaskScheduler ()
+{
+	removeAllJobs (true, 5000);
+
+	for (int i = 0; i < workers.size(); ++i)
+	{
+		workers.getUnchecked (i)->signalThreadShouldExit ();
+		workers.getUnchecked (i)->notify ();
+	}
+
+	for (int i = 0; i < workers.size(); ++i)
+		workers.getUnchecked (i)->stopThread (5000);
+
+	workers.clear ();
+}
+
+WorkStealingTaskScheduler::Worker* WorkStealingTaskScheduler::getCurrentWorker () const
+{
+	Worker* worker = dynamic_cast< Worker* > (Thread::getCurrentThread ());
+
+	if (worker != nullptr && &worker->owner == this)
+		return worker;
+
+	return nullptr;
+}
+
+void WorkStealingTaskScheduler::addJob (ThreadPoolJob* job, int priority)
+{
+	jassert (job != nullptr);
+	jassert (isPositiveAndBelow (priority, (int) numPriorities));
+
+	priority = jlimit (0, numPriorities - 1, priority);
+
+	Worker* worker = getCurrentWorker ();
+
+	if (worker == nullptr)
+	{
+		const int next = (++nextWorkerIndex) & 0x7fffffff;
+		worker = workers.getUnchecked (next % getNumThreads ());
+	}
+
+	{
+		const SpinLock::ScopedLockType sl (worker->lock);
+		worker->deques [priority].pushBack (job, Time::getMillisecondCounter ());
+	}
+
+	wakeWorker (*worker);
+}
+
+void WorkStealingTaskScheduler::addJobs (const Array< ThreadPoolJob* >& jobs, int priority)
+{
+	jassert (isPositiveAndBelow (priority, (int) numPriorities));
+
+	priority = jlimit (0, numPriorities - 1, priority);
+
+	const int numJobs = jobs.size();
+	if (numJobs == 0)
+		return;
+
+	const uint32 now = Time::getMillisecondCounter ();
+	Worker* currentWorker = getCurrentWorker ();
+
+	if (currentWorker != nullptr)
+	{
+		// Other workers will steal from the front of our deque if they're idle.
+		const SpinLock::ScopedLockType sl (currentWorker->lock);
+
+		for (int i = 0; i < numJobs; ++i)
+			currentWorker->deques [priority].pushBack (jobs.getUnchecked (i), now);
+	}
+	else
+	{
+		const int numWorkers = getNumThreads ();
+		const int numRuns = jmin (numJobs, numWorkers);
+		const int first = (nextWorkerIndex += numRuns) & 0x7fffffff;
+
+		for (int run = 0; run < numRuns; ++run)
+		{
+			Worker* worker = workers.getUnchecked ((first + run) % numWorkers);
+			const int start = (int) ((int64) numJobs * run / numRuns);
+			const int end = (int) ((int64) numJobs * (run + 1) / numRuns);
+
+			const SpinLock::ScopedLockType sl (worker->lock);
+
+			for (int i = start; i < end; ++i)
+				worker->deques [priority].pushBack (jobs.getUnchecked (i), now);
+		}
+	}
+
+	wakeIdleWorkers (numJobs);
+}
+
+void WorkStealingTaskScheduler::wakeIdleWorkers (int maxNumToWake)
+{
+	for (int i = 0; i < getNumThreads () && maxNumToWake > 0; ++i)
+	{
+		Worker* worker = workers.getUnchecked (i);
+
+		if (worker->idle.get() != 0)
+		{
+			worker->notify ();
+			--maxNumToWake;
+		}
+	}
+}
+
+void WorkStealingTaskScheduler::wakeWorker (Worker& preferredWorker)
+{
+	if (preferredWorker.idle.get() != 0)
+	{
+		preferredWorker.notify ();
+		return;
+	}
+
+	// The chosen worker is busy, so wake up an idle one to steal the job.
+	for (int i = 0; i < getNumThreads (); ++i)
+	{
+		Worker* worker = workers.getUnchecked (i);
+
+		if (worker->idle.get() != 0)
+		{
+			worker->notify ();
+			return;
+		}
+	}
+}
+
+ThreadPoolJob* WorkStealingTaskScheduler::takeAgedJob (Worker& worker)
+{
+	const uint32 now = Time::getMillisecondCounter ();
+
+	// Each worker only looks for an aged job once per aging interval. Once
+	// a lower class is saturated, every job in it is aged, so otherwise it
+	// would always be run ahead of the higher classes. It also keeps the
+	// search of the other workers' deques off the common path.
+	if (now - worker.lastAgingCheckTime < agingTime)
+		return nullptr;
+
+	worker.lastAgingCheckTime = now;
+
+	// Jobs on every worker's deques are considered (starting with our own),
+	// so that aged jobs on busy or parked workers are still promoted.
+	const int numWorkers = workers.size();
+
+	for (int i = 0; i < numWorkers; ++i)
+	{
+		Worker* victim = workers.getUnchecked ((worker.index + i) % numWorkers);
+		ThreadPoolJob* job = nullptr;
+		int jobPriority = 0;
+
+		{
+			const SpinLock::ScopedLockType sl (victim->lock);
+
+			// The top priority class can't be overtaken, so it never needs aging.
+			for (int priority = 0; priority < numPriorities - 1 && job == nullptr; ++priority)
+			{
+				JobDeque& deque = victim->deques [priority];
+
+				if (deque.size() > 0 && now - deque.getTimeQueuedOfFront () >= agingTime)
+				{
+					job = deque.popFront ();
+					jobPriority = priority;
+				}
+			}
+		}
+
+		if (job != nullptr)
+		{
+			const SpinLock::ScopedLockType sl (worker.lock);
+			worker.currentJob = job;
+			worker.currentJobPriority = jobPriority;
+			return job;
+		}
+	}
+
+	return nullptr;
+}
+
+ThreadPoolJob* WorkStealingTaskScheduler::findJobToRun (Worker& worker)
+{
+	ThreadPoolJob* agedJob = takeAgedJob (worker);
+	if (agedJob != nullptr)
+		return agedJob;
+
+	const int numWorkers = workers.size();
+
+	for (int priority = numPriorities; --priority >= 0;)
+	{
+		{
+			const SpinLock::ScopedLockType sl (worker.lock);
+
+			ThreadPoolJob* job = worker.deques [priority].popBack ();
+			if (job != nullptr)
+			{
+				worker.currentJob = job;
+				worker.currentJobPriority = priority;
+				return job;
+			}
+		}
+
+		for (int i = 1; i < numWorkers; ++i)
+		{
+			Worker* victim = workers.getUnchecked ((worker.index + i) % numWorkers);
+			ThreadPoolJob* job = nullptr;
+
+			{
+				const SpinLock::ScopedLockType sl (victim->lock);
+				job = victim->deques [priority].popFront ();
+			}
+
+			if (job != nullptr)
+			{
+				const SpinLock::ScopedLockType sl (worker.lock);
+				worker.currentJob = job;
+				worker.currentJobPriority = priority;
+				return job;
+			}
+		}
+	}
+
+	return nullptr;
+}
+
+void WorkStealingTaskScheduler::runJob (Worker& worker, ThreadPoolJob* job)
+{
+	const int64 startTicks = Time::getHighResolutionTicks ();
+	const double startCpu = Worker::getThreadCpuSeconds ();
+
+	const ThreadPoolJob::JobStatus status = job->runJob ();
+
+	const double busy = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks () - startTicks);
+	const double cpu = startCpu >= 0.0 ? Worker::getThreadCpuSeconds () - startCpu : 0.0;
+
+	const bool runAgain = (status == ThreadPoolJob::jobNeedsRunningAgain)
+							&& ! job->shouldExit ()
+							&& ! worker.threadShouldExit ();
+
+	{
+		const SpinLock::ScopedLockType sl (worker.lock);
+		worker.currentJob = nullptr;
+		worker.runGeneration++;
+		worker.numJobsRun++;
+		worker.busySeconds += busy;
+		worker.cpuSeconds += cpu;
+
+		if (runAgain)
+			worker.deques [worker.currentJobPriority].pushBack (job, Time::getMillisecondCounter ());
+	}
+
+	if (! runAgain)
+		delete job;
+
+	jobFinishedSignal.signal ();
+}
+
+int WorkStealingTaskScheduler::getNumJobs () const
+{
+	int total = 0;
+
+	for (int i = 0; i < workers.size(); ++i)
+	{
+		Worker* worker = workers.getUnchecked (i);
+		const SpinLock::ScopedLockType sl (worker->lock);
+
+		for (int priority = 0; priority < numPriorities; ++priority)
+			total += worker->deques [priority].size();
+
+		if (worker->currentJob != nullptr)
+			++total;
+	}
+
+	return total;
+}
+
+ThreadPoolJob* WorkStealingTaskScheduler::getJob (int index) const
+{
+	if (index < 0)
+		return nullptr;
+
+	// Running jobs come first, followed by each worker's queues in turn.
+	for (int i = 0; i < workers.size(); ++i)
+	{
+		Worker* worker = workers.getUnchecked (i);
+		const SpinLock::ScopedLockType sl (worker->lock);
+
+		if (worker->currentJob != nullptr)
+		{
+			if (index == 0)
+				return worker->currentJob;
+			--index;
+		}
+	}
+
+	for (int i = 0; i < workers.size(); ++i)
+	{
+		Worker* worker = workers.getUnchecked (i);
+		const SpinLock::ScopedLockType sl (worker->lock);
+
+		for (int priority = numPriorities; --priority >= 0;)
+		{
+			const JobDeque& deque = worker->deques [priority];
+
+			if (index < deque.size())
+				return deque [index];
+
+			index -= deque.size();
+		}
+	}
+
+	return nullptr;
+}
+
+bool WorkStealingTaskScheduler::isWorkerStillRunning (int workerIndex, int64 runGeneration) const
+{
+	Worker* worker = workers.getUnchecked (workerIndex);
+	const SpinLock::ScopedLockType sl (worker->lock);
+
+	return worker->runGeneration == runGeneration;
+}
+
+bool WorkStealingTaskScheduler::removeAllJobs (bool interruptRunningJobs, int timeOutMilliseconds,
+											   ThreadPool::JobSelector* selectedJobsToRemove)
+{
+	Array< ThreadPoolJob* > jobsToDelete;
+
+	// Running jobs are waited for by watching their workers, rather than by
+	// looking for their addresses, as a job's memory may be reused as soon
+	// as it has been deleted.
+	Array< int > runningWorkers;
+	Array< int64 > runningGenerations;
+
+	for (int i = 0; i < workers.size(); ++i)
+	{
+		Worker* worker = workers.getUnchecked (i);
+		const SpinLock::ScopedLockType sl (worker->lock);
+
+		for (int priority = 0; priority < numPriorities; ++priority)
+			worker->deques [priority].removeMatching (selectedJobsToRemove, jobsToDelete);
+
+		ThreadPoolJob* job = worker->currentJob;
+		if (job != nullptr && (selectedJobsToRemove == nullptr || selectedJobsToRemove->isJobSuitable (job)))
+		{
+			if (interruptRunningJobs)
+				job->signalJobShouldExit ();
+
+			runningWorkers.add (i);
+			runningGenerations.add (worker->runGeneration);
+		}
+	}
+
+	for (int i = 0; i < jobsToDelete.size(); ++i)
+		delete jobsToDelete.getUnchecked (i);
+
+	const uint32 start = Time::getMillisecondCounter ();
+
+	for (int i = runningWorkers.size(); --i >= 0;)
+	{
+		while (isWorkerStillRunning (runningWorkers.getUnchecked (i), runningGenerations.getUnchecked (i)))
+		{
+			if (timeOutMilliseconds >= 0 && Time::getMillisecondCounter () >= start + (uint32) timeOutMilliseconds)
+				return false;
+
+			jobFinishedSignal.wait (2);
+		}
+	}
+
+	return true;
+}
+
+int WorkStealingTaskScheduler::getNumThreads () const
+{
+	return numActiveWorkers.get();
+}
+
+bool WorkStealingTaskScheduler::setNumThreads (int newNumThreads)
+{
+	newNumThreads = jlimit (1, workers.size(), newNumThreads);
+	const int oldNumThreads = numActiveWorkers.exchange (newNumThreads);
+
+	// Newly active workers are woken so they can start stealing, and parked
+	// ones so that they notice and go back to sleep.
+	for (int i = jmin (oldNumThreads, newNumThreads); i < workers.size(); ++i)
+		workers.getUnchecked (i)->notify ();
+
+	return true;
+}
+
+bool WorkStealingTaskScheduler::setCpuAffinity (const BigInteger& cpus)
+{
+	{
+		const SpinLock::ScopedLockType sl (affinityLock);
+		cpuAffinity = cpus;
+		++affinityGeneration;
+	}
+
+	for (int i = 0; i < workers.size(); ++i)
+		workers.getUnchecked (i)->notify ();
+
+	return true;
+}
+
+TaskScheduler::Statistics WorkStealingTaskScheduler::getStatistics () const
+{
+	Statistics stats;
+	stats.numThreads = getNumThreads ();
+	stats.cpuSeconds = Worker::getThreadCpuSeconds () >= 0.0 ? 0.0 : -1.0;
+
+	for (int i = 0; i < workers.size(); ++i)
+	{
+		Worker* worker = workers.getUnchecked (i);
+		const SpinLock::ScopedLockType sl (worker->lock);
+
+		stats.numJobsRun += worker->numJobsRun;
+		stats.busySeconds += worker->busySeconds;
+
+		if (stats.cpuSeconds >= 0.0)
+			stats.cpuSeconds += worker->cpuSeconds;
+
+		for (int priority = 0; priority < numPriorities; ++priority)
+			stats.numQueuedJobs += worker->deques [priority].size();
+	}
+
+	return stats;
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,82 @@
+#ifndef WORKSTEALINGTASKSCHEDULER_H_INCLUDED
+#define WORKSTEALINGTASKSCHEDULER_H_INCLUDED
+
+///////////////////////////////////////////////////////////////////////////////
+/**
+	TaskScheduler which gives each worker thread its own job deque, rather
+	than keeping all jobs in one shared list.
+
+	Jobs added from one of this scheduler's own workers go onto that worker's
+	deque, and jobs added from any other thread are distributed between the
+	workers in turn. A worker takes jobs from the back of its own deque, and
+	when that is empty it steals from the front of another worker's deque.
+	Each deque has its own lock, so producers and workers only contend with
+	each other when they touch the same deque.
+
+	Each worker actually has one deque per priority class, and the higher
+	classes are always searched (on every worker) before the lower ones. So
+	that a steady stream of high priority jobs can't starve the rest, a job
+	which has been waiting for longer than the aging time (on any worker) is
+	run ahead of any higher priority work. Each worker only does this once
+	per aging interval, so a saturated lower class just gets a small share
+	of the workers' time rather than holding up everything above it.
+
+	The scheduler can be resized at run time, up to the number of threads
+	it was created with. Workers beyond the current size are parked: they
+	don't take any jobs until the scheduler grows again, and any jobs left
+	on their deques are stolen by the active workers.
+*/
+///////////////////////////////////////////////////////////////////////////////
+
+class WorkStealingTaskScheduler	:	public TaskScheduler
+{
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WorkStealingTaskScheduler);
+public:
+
+	WorkStealingTaskScheduler (int numberOfThreads, int agingTimeMilliseconds = 100);
+	virtual ~WorkStealingTaskScheduler ();
+
+	virtual void addJob (juce::ThreadPoolJob* job, int priority) override;
+
+	/** Queues a batch of jobs. The batch is split into one contiguous run per
+		worker (or all put on the calling worker's own deque), so each deque
+		is only locked once, and then as many idle workers are woken as
+		there are jobs for. */
+	virtual void addJobs (const juce::Array< juce::ThreadPoolJob* >& jobs, int priority) override;
+	virtual int getNumJobs () const override;
+	virtual juce::ThreadPoolJob* getJob (int index) const override;
+	virtual bool removeAllJobs (bool interruptRunningJobs, int timeOutMilliseconds,
+								juce::ThreadPool::JobSelector* selectedJobsToRemove = nullptr) override;
+	virtual int getNumThreads () const override;
+	virtual bool setNumThreads (int newNumThreads) override;
+	virtual bool setCpuAffinity (const juce::BigInteger& cpus) override;
+	virtual Statistics getStatistics () const override;
+
+private:
+
+	class JobDeque;
+	class Worker;
+	friend class Worker;
+
+	Worker* getCurrentWorker () const;
+	juce::ThreadPoolJob* findJobToRun (Worker& worker);
+	juce::ThreadPoolJob* takeAgedJob (Worker& worker);
+	void runJob (Worker& worker, juce::ThreadPoolJob* job);
+	void wakeWorker (Worker& preferredWorker);
+	void wakeIdleWorkers (int maxNumToWake);
+	bool isWorkerStillRunning (int workerIndex, juce::int64 runGeneration) const;
+
+	juce::OwnedArray< Worker > workers;
+	juce::WaitableEvent jobFinishedSignal;
+	juce::Atomic< int > nextWorkerIndex;
+	juce::Atomic< int > numActiveWorkers;
+	juce::SpinLock affinityLock;
+	juce::BigInteger cpuAffinity;	// guarded by affinityLock
+	juce::Atomic< int > affinityGeneration;
+	const juce::uint32 agingTime;
+
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif//WORKSTEALINGTASKSCHEDULER_H_INCLUDED
@@ -0,0 +1,110 @@
+#ifndef RECYCLINGALLOCATOR_H_INCLUDED
+#define RECYCLINGALLOCATOR_H_INCLUDED
+
+///////////////////////////////////////////////////////////////////////////////
+/**
+	Allocator for objects which are created and destroyed very frequently.
+	Freed blocks are kept on a free list and handed out again, so once it has
+	warmed up, creating one of these objects doesn't touch the heap at all.
+
+	Use it by giving the class its own operator new and delete, e.g.
+
+	class MyClass
+	{
+	public:
+		static void* operator new (size_t size)				{ return Allocator::allocate (size); }
+		static void operator delete (void* block, size_t size)	{ Allocator::deallocate (block, size); }
+	private:
+		typedef RecyclingAllocator< 128 > Allocator;
+	};
+
+	Requests larger than BlockSize (e.g. from a subclass) just go to the heap.
+	At most MaxCachedBlocks are kept for reuse, and these are never freed.
+*/
+///////////////////////////////////////////////////////////////////////////////
+
+template <size_t BlockSize, int MaxCachedBlocks = 256>
+class RecyclingAllocator
+{
+public:
+
+	static void* allocate (size_t size)
+	{
+		if (size <= BlockSize)
+		{
+			FreeList& freeList = getFreeList ();
+			const juce::SpinLock::ScopedLockType sl (freeList.lock);
+
+			if (freeList.head != nullptr && ! freeList.disabled)
+			{
+				FreeBlock* block = freeList.head;
+				freeList.head = block->next;
+				--freeList.numBlocks;
+				return block;
+			}
+		}
+
+		return ::operator new (juce::jmax (size, (size_t) BlockSize));
+	}
+
+	static void deallocate (void* block, size_t size)
+	{
+		if (block == nullptr)
+			return;
+
+		if (size <= BlockSize)
+		{
+			FreeList& freeList = getFreeList ();
+			const juce::SpinLock::ScopedLockType sl (freeList.lock);
+
+			if (freeList.numBlocks < MaxCachedBlocks && ! freeList.disabled)
+			{
+				FreeBlock* freeBlock = static_cast< FreeBlock* > (block);
+				freeBlock->next = freeList.head;
+				freeList.head = freeBlock;
+				++freeList.numBlocks;
+				return;
+			}
+		}
+
+		::operator delete (block);
+	}
+
+	/** Turns recycling on or off (e.g. to measure the difference it makes).
+		It is on by default. */
+	static void setEnabled (bool shouldBeEnabled)
+	{
+		FreeList& freeList = getFreeList ();
+		const juce::SpinLock::ScopedLockType sl (freeList.lock);
+		freeList.disabled = ! shouldBeEnabled;
+	}
+
+private:
+
+	struct FreeBlock
+	{
+		FreeBlock* next;
+	};
+
+	static_jassert (BlockSize >= sizeof (FreeBlock));
+
+	// This lives in zero-initialised static storage, and is never destroyed,
+	// so it's safe to use at any point during shutdown.
+	struct FreeList
+	{
+		juce::SpinLock lock;
+		FreeBlock* head;
+		int numBlocks;
+		bool disabled;
+	};
+
+	static FreeList& getFreeList ()
+	{
+		RETURN_FUNCTION_STATIC_STRUCT(FreeList);
+	}
+
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif//RECYCLINGALLOCATOR_H_INCLUDED
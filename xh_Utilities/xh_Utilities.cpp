@@ -1,5 +1,10 @@
 #include "xh_Utilities.h"
 
+#if JUCE_LINUX || JUCE_ANDROID
+ #include <time.h>
+ #include <sched.h>
+#endif
+
 using namespace juce;
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -8,20 +13,35 @@ using namespace juce;
 #include "misc/ArrayDuplicateScanner.cpp"
 #include "misc/RelativeWeightSequence.cpp"
 #include "misc/Version.cpp"
+#include "misc/CpuTopology.cpp"
 
+#include "tasks/CancellationToken.cpp"
+#include "tasks/TaskResultCache.cpp"
 #include "tasks/TaskSequence.cpp"
+#include "tasks/TaskDispatcher.cpp"
+#include "tasks/TaskWatchdog.cpp"
 #include "tasks/ProgressiveTask.cpp"
+#include "tasks/TaskTracer.cpp"
+#include "tasks/ResumableTask.cpp"
 #include "tasks/DummyTask.cpp"
 #include "tasks/SerialTask.cpp"
+#include "tasks/TaskGraph.cpp"
 #include "tasks/MemberFunctionTask.cpp"
 #include "tasks/TaskHandler.cpp"
 
 #include "tasks/execution/TaskThreadPoolJob.cpp"
-#include "tasks/execution/TaskQueue.cpp"
+#include "tasks/execution/TaskScheduler.cpp"
+#include "tasks/execution/WorkStealingTaskScheduler.cpp"
 #include "tasks/execution/TaskThread.cpp"
 #include "tasks/execution/PooledTaskRunner.cpp"
+#include "tasks/execution/TaskQueue.cpp"
 #include "tasks/execution/PooledTaskListView.cpp"
 #include "tasks/execution/ModalTaskPopup.cpp"
 #include "tasks/execution/TaskThreadWithProgressWindow.cpp"
 
+#include "benchmarks/PoolThroughput.cpp"
+#include "benchmarks/TaskThreadPoolBenchmark.cpp"
+#include "benchmarks/TaskPriorityBenchmark.cpp"
+#include "benchmarks/TaskOverheadBenchmark.cpp"
+
 ///////////////////////////////////////////////////////////////////////////////
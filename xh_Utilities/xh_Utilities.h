@@ -5,31 +5,52 @@
 #include "modules/juce_core/juce_core.h"
 #include "modules/juce_gui_basics/juce_gui_basics.h"
 
+///////////////////////////////////////////////////////////////////////////////
+/** Config: XH_INCLUDE_BENCHMARKS
+	Set this to 1 to include the benchmarks for the task classes. These are
+	registered as juce::UnitTests, but as they take a while to run they are
+	left out by default.
+*/
+#ifndef XH_INCLUDE_BENCHMARKS
+ #define XH_INCLUDE_BENCHMARKS 0
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "misc/DestructionNotifier.h"
 #include "misc/ArrayDuplicateScanner.h"
 #include "misc/RelativeWeightSequence.h"
 #include "misc/Version.h"
+#include "misc/CpuTopology.h"
 
 #include "templates/AsyncCallback.h"
 #include "templates/Singleton.h"
+#include "templates/RecyclingAllocator.h"
 #include "templates/Factory.h"
 #include "templates/SubClassWeakReference.h"
 #include "templates/MessageThreadScopedPtr.h"
 #include "templates/OverridableSharedResourcePointer.h"
 
+#include "tasks/CancellationToken.h"
+#include "tasks/TaskResultCache.h"
 #include "tasks/TaskSequence.h"
+#include "tasks/TaskDispatcher.h"
+#include "tasks/TaskWatchdog.h"
 #include "tasks/ProgressiveTask.h"
+#include "tasks/TaskTracer.h"
+#include "tasks/ResumableTask.h"
 #include "tasks/DummyTask.h"
 #include "tasks/SerialTask.h"
+#include "tasks/TaskGraph.h"
 #include "tasks/MemberFunctionTask.h"
 #include "tasks/TaskHandler.h"
 
 #include "tasks/execution/TaskThreadPoolJob.h"
-#include "tasks/execution/TaskQueue.h"
+#include "tasks/execution/TaskScheduler.h"
+#include "tasks/execution/WorkStealingTaskScheduler.h"
 #include "tasks/execution/TaskThread.h"
 #include "tasks/execution/PooledTaskRunner.h"
+#include "tasks/execution/TaskQueue.h"
 #include "tasks/execution/PooledTaskListView.h"
 #include "tasks/execution/ModalTaskPopup.h"
 #include "tasks/execution/TaskThreadWithProgressWindow.h"